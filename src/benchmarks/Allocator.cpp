@@ -0,0 +1,515 @@
+// Simple Allocator 2024
+#include "CycleCounter.h"
+#include "PerfCounters.h"
+#include "SimpleAllocator.h"
+#include "StreamingCopy.h"
+
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = size_t{1} << 31;
+constexpr size_t BATCH_SIZE = 4096;
+constexpr size_t MAX_RANDOM_SIZE = 256 * 1024;
+
+enum FreeOrder { LIFO, FIFO, RANDOM };
+
+class DirectAllocator {
+public:
+  DirectAllocator() noexcept
+    : buffer_(new uint8_t[BUFFER_SIZE])
+    , allocator_(std::make_unique<SimpleAllocator>()) {
+    allocator_->Init(buffer_.get(), BUFFER_SIZE);
+  }
+
+  SimpleAllocator *operator->() noexcept {
+    return allocator_.get();
+  }
+
+  SimpleAllocator &operator*() noexcept {
+    return *allocator_;
+  }
+
+private:
+  std::unique_ptr<uint8_t[]> buffer_;
+  std::unique_ptr<SimpleAllocator> allocator_;
+};
+
+class OperationTimer {
+public:
+  void Start() noexcept {
+    perf_counters_.Resume();
+    start_time_ = std::chrono::steady_clock::now();
+    start_cycles_ = ReadCycleCounter();
+  }
+
+  void Stop(size_t operations) noexcept {
+    cycles_ += ReadCycleCounter() - start_cycles_;
+    nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+    perf_counters_.Pause();
+    operations_ += operations;
+  }
+
+  void Report(benchmark::State &state) const {
+    perf_counters_.Report(state);
+    const auto operations = static_cast<double>(std::max(operations_, size_t{1}));
+    state.counters["ns/op"] = static_cast<double>(nanoseconds_) / operations;
+    state.counters["cycles/op"] = static_cast<double>(cycles_) / operations;
+  }
+
+private:
+  PerfCounters perf_counters_;
+  std::chrono::steady_clock::time_point start_time_;
+  uint64_t start_cycles_{0};
+  uint64_t cycles_{0};
+  int64_t nanoseconds_{0};
+  size_t operations_{0};
+};
+
+// Cycle percentiles of every sampled allocation path, available with SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+void ReportLatencyPercentiles(benchmark::State &state, DirectAllocator &allocator) {
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+  for (size_t i = 0; i != static_cast<size_t>(AllocationPath::COUNT); ++i) {
+    const auto path = static_cast<AllocationPath>(i);
+    const LatencyHistogram &histogram = allocator->GetLatencyHistograms().Get(path);
+    if (!histogram.Count()) {
+      continue;
+    }
+    const std::string name = GetAllocationPathName(path);
+    state.counters[name + "_p50"] = static_cast<double>(histogram.Percentile(50.0));
+    state.counters[name + "_p99"] = static_cast<double>(histogram.Percentile(99.0));
+    state.counters[name + "_p99.9"] = static_cast<double>(histogram.Percentile(99.9));
+    state.counters[name + "_max"] = static_cast<double>(histogram.Max());
+  }
+#else
+  (void)state;
+  (void)allocator;
+#endif
+}
+
+std::vector<size_t> MakeFreeOrder(FreeOrder free_order, size_t count) {
+  std::vector<size_t> order(count);
+  std::iota(order.begin(), order.end(), size_t{0});
+  if (free_order == LIFO) {
+    std::reverse(order.begin(), order.end());
+  } else if (free_order == RANDOM) {
+    std::shuffle(order.begin(), order.end(), std::mt19937_64{42});
+  }
+  return order;
+}
+
+template<class Distribution>
+std::vector<size_t> MakeSizes(Distribution distribution) {
+  std::mt19937_64 generator{7};
+  std::vector<size_t> sizes(BATCH_SIZE);
+  for (auto &size : sizes) {
+    size = std::clamp(static_cast<size_t>(distribution(generator)), size_t{1}, MAX_RANDOM_SIZE);
+  }
+  return sizes;
+}
+
+void AllocateAndFree(benchmark::State &state, const std::vector<size_t> &sizes, const std::vector<size_t> &free_order) {
+  DirectAllocator allocator;
+  std::vector<void *> pointers(sizes.size());
+  OperationTimer timer;
+  for (auto _ : state) {
+    timer.Start();
+    for (size_t i = 0; i != sizes.size(); ++i) {
+      pointers[i] = allocator->Allocate(sizes[i]);
+    }
+    benchmark::DoNotOptimize(pointers.data());
+    for (size_t i : free_order) {
+      allocator->Deallocate(pointers[i]);
+    }
+    timer.Stop(sizes.size() * 2);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  ReportLatencyPercentiles(state, allocator);
+}
+
+// Vector of trivial elements growing by 1.5x, which either takes the capacity it asked for
+// or the whole usable block returned by AllocateAtLeast.
+template<class T, bool USE_SLACK>
+class GrowingArray {
+public:
+  explicit GrowingArray(SimpleAllocator &allocator) noexcept
+    : allocator_(&allocator) {}
+
+  void Append(const T *values, size_t count) noexcept {
+    if (size_ + count > capacity_) {
+      Grow(size_ + count);
+    }
+    std::memcpy(data_ + size_, values, count * sizeof(T));
+    size_ += count;
+  }
+
+  void Free() noexcept {
+    allocator_->Deallocate(data_);
+    data_ = nullptr;
+    size_ = capacity_ = reallocations_ = 0;
+  }
+
+  size_t Size() const noexcept {
+    return size_;
+  }
+
+  size_t Reallocations() const noexcept {
+    return reallocations_;
+  }
+
+private:
+  void Grow(size_t min_capacity) noexcept {
+    const size_t capacity = std::max(min_capacity, capacity_ + capacity_ / 2);
+    T *data;
+    if constexpr (USE_SLACK) {
+      auto [ptr, usable_size] = allocator_->AllocateAtLeast(capacity * sizeof(T));
+      data = static_cast<T *>(ptr);
+      capacity_ = usable_size / sizeof(T);
+    } else {
+      data = static_cast<T *>(allocator_->Allocate(capacity * sizeof(T)));
+      capacity_ = capacity;
+    }
+    if (data_) {
+      std::memcpy(data, data_, size_ * sizeof(T));
+      allocator_->Deallocate(data_);
+      ++reallocations_;
+    }
+    data_ = data;
+  }
+
+  SimpleAllocator *allocator_;
+  T *data_{nullptr};
+  size_t size_{0};
+  size_t capacity_{0};
+  size_t reallocations_{0};
+};
+
+// Leaves free blocks of random sizes in the tree, so the growing arrays get blocks with unsplit remainders
+void FragmentHeap(SimpleAllocator &allocator) {
+  std::mt19937_64 generator{3};
+  std::uniform_int_distribution<size_t> sizes{16 * 1024, 1024 * 1024};
+  std::vector<void *> holes;
+  for (size_t i = 0; i != 1024; ++i) {
+    holes.push_back(allocator.Allocate(sizes(generator)));
+    allocator.Allocate(16);
+  }
+  for (void *hole : holes) {
+    allocator.Deallocate(hole);
+  }
+}
+
+// Grows BATCH_SIZE arrays to log-normal lengths in round robin, CHUNK elements per append
+template<class T, size_t CHUNK, bool USE_SLACK>
+void GrowArrays(benchmark::State &state) {
+  DirectAllocator allocator;
+  FragmentHeap(*allocator);
+  std::lognormal_distribution<double> log_normal{std::log(256.0), 1.4};
+  const auto lengths = MakeSizes([&log_normal](std::mt19937_64 &generator) { return log_normal(generator); });
+  const std::array<T, CHUNK> values{};
+
+  std::vector<GrowingArray<T, USE_SLACK>> arrays(lengths.size(), GrowingArray<T, USE_SLACK>{*allocator});
+  std::vector<size_t> growing;
+  size_t reallocations = 0;
+  OperationTimer timer;
+  for (auto _ : state) {
+    growing.resize(lengths.size());
+    std::iota(growing.begin(), growing.end(), size_t{0});
+    size_t operations = 0;
+    timer.Start();
+    while (!growing.empty()) {
+      for (size_t i = 0; i < growing.size();) {
+        auto &array = arrays[growing[i]];
+        array.Append(values.data(), std::min(CHUNK, lengths[growing[i]] - array.Size()));
+        ++operations;
+        if (array.Size() == lengths[growing[i]]) {
+          growing[i] = growing.back();
+          growing.pop_back();
+        } else {
+          ++i;
+        }
+      }
+    }
+    for (auto &array : arrays) {
+      reallocations += array.Reallocations();
+      array.Free();
+    }
+    timer.Stop(operations);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  state.counters["reallocations"] = benchmark::Counter(static_cast<double>(reallocations), benchmark::Counter::kAvgIterations);
+}
+
+} // namespace
+
+template<FreeOrder FREE_ORDER>
+static void Allocator_FixedSize(benchmark::State &state) {
+  const std::vector<size_t> sizes(BATCH_SIZE, static_cast<size_t>(state.range(0)));
+  AllocateAndFree(state, sizes, MakeFreeOrder(FREE_ORDER, sizes.size()));
+}
+
+// Slot boundaries: the smallest slots, the last slot (16368), the tree cutoff (16384) and sizes above it
+static void FixedSizes(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("size");
+  for (int64_t size : {16, 17, 64, 256, 1024, 4096, 16368, 16384, 16400, 65536}) {
+    benchmark->Arg(size);
+  }
+}
+
+BENCHMARK(Allocator_FixedSize<LIFO>)->Apply(FixedSizes);
+BENCHMARK(Allocator_FixedSize<FIFO>)->Apply(FixedSizes);
+BENCHMARK(Allocator_FixedSize<RANDOM>)->Apply(FixedSizes);
+
+template<FreeOrder FREE_ORDER>
+static void Allocator_PowerLaw(benchmark::State &state) {
+  // Pareto distribution with the shape 1.1, most sizes are tiny, some are huge
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  const auto sizes = MakeSizes([&uniform](std::mt19937_64 &generator) { return 16.0 * std::pow(1.0 - uniform(generator), -1.0 / 1.1); });
+  AllocateAndFree(state, sizes, MakeFreeOrder(FREE_ORDER, sizes.size()));
+}
+
+BENCHMARK(Allocator_PowerLaw<LIFO>);
+BENCHMARK(Allocator_PowerLaw<FIFO>);
+BENCHMARK(Allocator_PowerLaw<RANDOM>);
+
+template<FreeOrder FREE_ORDER>
+static void Allocator_LogNormal(benchmark::State &state) {
+  // The median is 256 bytes, one sigma covers roughly [64, 1024]
+  std::lognormal_distribution<double> log_normal{std::log(256.0), 1.4};
+  const auto sizes = MakeSizes([&log_normal](std::mt19937_64 &generator) { return log_normal(generator); });
+  AllocateAndFree(state, sizes, MakeFreeOrder(FREE_ORDER, sizes.size()));
+}
+
+BENCHMARK(Allocator_LogNormal<LIFO>);
+BENCHMARK(Allocator_LogNormal<FIFO>);
+BENCHMARK(Allocator_LogNormal<RANDOM>);
+
+// Buffers per request over a fragmented heap: a request frees its buffer and the next one allocates the same size right away,
+// with every other block of a few thousand large sizes free in the index around them
+static void Allocator_RequestBuffers(benchmark::State &state) {
+  DirectAllocator allocator;
+  std::mt19937_64 generator{46};
+  std::vector<void *> background(BATCH_SIZE);
+  for (auto &ptr : background) {
+    ptr = allocator->Allocate(SimpleAllocatorTraits::MAX_SLOT_SIZE + 16 * (generator() % 16384));
+  }
+  for (size_t i = 0; i < background.size(); i += 2) {
+    allocator->Deallocate(background[i]);
+  }
+
+  const auto buffer_size = static_cast<size_t>(state.range(0));
+  std::vector<void *> buffers(64);
+  for (auto &buffer : buffers) {
+    buffer = allocator->Allocate(buffer_size);
+  }
+  OperationTimer timer;
+  for (auto _ : state) {
+    timer.Start();
+    for (size_t i = 0; i != BATCH_SIZE; ++i) {
+      void *&buffer = buffers[i % buffers.size()];
+      allocator->Deallocate(buffer);
+      buffer = allocator->Allocate(buffer_size);
+    }
+    timer.Stop(BATCH_SIZE * 2);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  ReportLatencyPercentiles(state, allocator);
+}
+
+BENCHMARK(Allocator_RequestBuffers)->ArgName("size")->Arg(32 * 1024)->Arg(100 * 1024);
+
+// A std::list of long strings with FIFO churn as in ListHugeElement, but with lengths spread around the tree cutoff: a node
+// and a string per element. Strings just over the cutoff take tree blocks with rests under it, which stay with the allocation
+// or are split off into slots from split_from bytes on. heap_per_live is the peak heap extent over the live bytes.
+static void Allocator_HugeElementList(benchmark::State &state) {
+  constexpr size_t NODE_SIZE = 48;
+  struct Element {
+    void *node;
+    void *string;
+    size_t length;
+  };
+  const auto elements = static_cast<size_t>(state.range(0));
+  const auto split_from = static_cast<size_t>(state.range(1));
+  std::mt19937_64 generator{50};
+  std::uniform_int_distribution<size_t> lengths{8 * 1024, 48 * 1024};
+  size_t peak_heap_extent = 0;
+  size_t peak_live_bytes = 0;
+  OperationTimer timer;
+  for (auto _ : state) {
+    state.PauseTiming();
+    DirectAllocator allocator;
+    allocator->SetSlotSplitThreshold(split_from);
+    std::deque<Element> list;
+    size_t live_bytes = 0;
+    state.ResumeTiming();
+    timer.Start();
+    for (size_t i = 0; i != 16 * elements; ++i) {
+      if (list.size() == elements) {
+        live_bytes -= NODE_SIZE + list.front().length + 1;
+        allocator->Deallocate(list.front().string);
+        allocator->Deallocate(list.front().node);
+        list.pop_front();
+      }
+      const size_t length = lengths(generator);
+      list.push_back({allocator->Allocate(NODE_SIZE), allocator->Allocate(length + 1), length});
+      live_bytes += NODE_SIZE + length + 1;
+      peak_heap_extent = std::max(peak_heap_extent, allocator->HeapExtent());
+      peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+    }
+    timer.Stop(16 * elements * 2);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  state.counters["heap_extent"] = benchmark::Counter(static_cast<double>(peak_heap_extent), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["heap_per_live"] = static_cast<double>(peak_heap_extent) / static_cast<double>(std::max<size_t>(peak_live_bytes, 1));
+}
+
+// A split_from over the slot sizes leaves every rest with the allocation, as by default
+BENCHMARK(Allocator_HugeElementList)
+  ->ArgNames({"elements", "split_from"})
+  ->ArgsProduct({{1024, 16 * 1024}, {0, 1024, 4096, 8192, 32 * 1024}})
+  ->Unit(benchmark::kMillisecond);
+
+static void Allocator_ReallocGrowth(benchmark::State &state) {
+  DirectAllocator allocator;
+  const auto chains = static_cast<size_t>(state.range(0));
+  const size_t max_size = static_cast<size_t>(state.range(1));
+  std::vector<void *> pointers(chains);
+  OperationTimer timer;
+  for (auto _ : state) {
+    size_t operations = 0;
+    timer.Start();
+    // Chains grow interleaved, so only the last one can be extended in place
+    for (size_t size = 16; size <= max_size; size += size / 2) {
+      for (auto &ptr : pointers) {
+        ptr = allocator->Reallocate(ptr, size);
+      }
+      operations += chains;
+    }
+    for (auto &ptr : pointers) {
+      allocator->Deallocate(ptr);
+      ptr = nullptr;
+    }
+    operations += chains;
+    timer.Stop(operations);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  ReportLatencyPercentiles(state, allocator);
+}
+
+BENCHMARK(Allocator_ReallocGrowth)->ArgNames({"chains", "max_size"})->ArgsProduct({{1, 4, 64}, {4096, 64 * 1024, 1024 * 1024}});
+
+// Interleaved buffers which grow by a fixed step, as a log or a request body read in pieces, with the share of calls which moved memory
+static void Allocator_ReallocAppend(benchmark::State &state) {
+  DirectAllocator allocator;
+  const auto chains = static_cast<size_t>(state.range(0));
+  const size_t max_size = static_cast<size_t>(state.range(1));
+  constexpr size_t STEP = 256;
+  std::vector<void *> pointers(chains);
+  size_t moves = 0;
+  OperationTimer timer;
+  for (auto _ : state) {
+    size_t operations = 0;
+    timer.Start();
+    for (size_t size = STEP; size <= max_size; size += STEP) {
+      for (auto &ptr : pointers) {
+        void *new_ptr = allocator->Reallocate(ptr, size);
+        moves += new_ptr != ptr ? 1 : 0;
+        ptr = new_ptr;
+      }
+      operations += chains;
+    }
+    for (auto &ptr : pointers) {
+      allocator->Deallocate(ptr);
+      ptr = nullptr;
+    }
+    operations += chains;
+    timer.Stop(operations);
+    benchmark::ClobberMemory();
+  }
+  timer.Report(state);
+  state.counters["moves"] = benchmark::Counter(static_cast<double>(moves), benchmark::Counter::kAvgIterations);
+  ReportLatencyPercentiles(state, allocator);
+}
+
+BENCHMARK(Allocator_ReallocAppend)->ArgNames({"chains", "max_size"})->ArgsProduct({{4, 64}, {64 * 1024, 1024 * 1024}});
+
+enum CopyMode { MEMCPY, STREAMING };
+
+// Large growth chains which fill their new space, with a sweep over a working set between the rounds.
+// The moves go through the caches with std::memcpy or around them with StreamingCopy, sweep_ns shows what that leaves of the working set.
+template<CopyMode COPY_MODE>
+static void Allocator_ReallocGrowthWorkingSet(benchmark::State &state) {
+  constexpr size_t working_set_size = 1024 * 1024;
+  DirectAllocator allocator;
+  allocator->SetStreamingCopyThreshold(COPY_MODE == STREAMING ? 0 : SIZE_MAX);
+  const auto chains = static_cast<size_t>(state.range(0));
+  const size_t max_size = static_cast<size_t>(state.range(1));
+  std::vector<void *> pointers(chains);
+  std::vector<uint64_t> working_set(working_set_size / sizeof(uint64_t), 1);
+  OperationTimer timer;
+  int64_t sweep_nanoseconds = 0;
+  size_t sweeps = 0;
+  for (auto _ : state) {
+    size_t previous_size = 0;
+    for (size_t size = 64 * 1024; size <= max_size; previous_size = size, size += size / 2) {
+      timer.Start();
+      for (auto &ptr : pointers) {
+        ptr = allocator->Reallocate(ptr, size);
+      }
+      timer.Stop(chains);
+      for (auto *ptr : pointers) {
+        std::memset(static_cast<uint8_t *>(ptr) + previous_size, 1, size - previous_size);
+      }
+
+      const auto sweep_start = std::chrono::steady_clock::now();
+      benchmark::DoNotOptimize(std::accumulate(working_set.begin(), working_set.end(), uint64_t{0}));
+      sweep_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sweep_start).count();
+      ++sweeps;
+    }
+    for (auto &ptr : pointers) {
+      allocator->Deallocate(ptr);
+      ptr = nullptr;
+    }
+  }
+  timer.Report(state);
+  state.counters["sweep_ns"] = static_cast<double>(sweep_nanoseconds) / static_cast<double>(std::max(sweeps, size_t{1}));
+  state.SetLabel(COPY_MODE == STREAMING ? GetStreamingCopyName() : "memcpy");
+}
+
+BENCHMARK(Allocator_ReallocGrowthWorkingSet<MEMCPY>)->ArgNames({"chains", "max_size"})->ArgsProduct({{1, 4}, {1024 * 1024, 16 * 1024 * 1024}});
+BENCHMARK(Allocator_ReallocGrowthWorkingSet<STREAMING>)->ArgNames({"chains", "max_size"})->ArgsProduct({{1, 4}, {1024 * 1024, 16 * 1024 * 1024}});
+
+// push_back of 8-byte elements
+template<bool USE_SLACK>
+static void Allocator_SlackVector(benchmark::State &state) {
+  GrowArrays<int64_t, 1, USE_SLACK>(state);
+}
+
+BENCHMARK(Allocator_SlackVector<false>);
+BENCHMARK(Allocator_SlackVector<true>);
+
+// Appends of 7 characters, so capacities are rarely multiples of the alignment
+template<bool USE_SLACK>
+static void Allocator_SlackString(benchmark::State &state) {
+  GrowArrays<char, 7, USE_SLACK>(state);
+}
+
+BENCHMARK(Allocator_SlackString<false>);
+BENCHMARK(Allocator_SlackString<true>);
+
+BENCHMARK_MAIN();
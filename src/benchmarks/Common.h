@@ -1,22 +1,74 @@
 // Simple Allocator 2024
 #ifndef BENCHMARKS_COMMON_H
 #define BENCHMARKS_COMMON_H
+#include "PerfCounters.h"
 
-void EnableBenchmarkAllocator(bool use_simple_allocator) noexcept;
-void DisableBenchmarkAllocator() noexcept;
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <string>
 
-enum AllocatorType { SIMPLE_ALLOCATOR, VANILLA_MALLOC };
+size_t GetBenchmarkBackendsCount() noexcept;
+const char *GetBenchmarkBackendName(size_t backend) noexcept;
+bool IsBenchmarkBackendAvailable(size_t backend) noexcept;
+bool DoesBenchmarkBackendReuseMemory(size_t backend) noexcept;
+void EnableBenchmarkAllocator(size_t backend) noexcept;
+void DisableBenchmarkAllocator() noexcept;
 
-template<AllocatorType ALLOCATOR_TYPE>
+// Switches malloc to the backend and collects perf counters of the timed part of the benchmark
 class ScopedBenchmarkAllocatorReplacement {
 public:
-  ScopedBenchmarkAllocatorReplacement() noexcept {
-    EnableBenchmarkAllocator(ALLOCATOR_TYPE == SIMPLE_ALLOCATOR);
+  ScopedBenchmarkAllocatorReplacement(benchmark::State &state, size_t backend) noexcept
+    : state_(state) {
+    EnableBenchmarkAllocator(backend);
+    perf_counters_.Resume();
+  }
+
+  void PauseTiming() noexcept {
+    perf_counters_.Pause();
+    state_.PauseTiming();
   }
 
+  void ResumeTiming() noexcept {
+    state_.ResumeTiming();
+    perf_counters_.Resume();
+  }
+
+  // The counters are reported with the system heap, they outlive the benchmark heap
   ~ScopedBenchmarkAllocatorReplacement() noexcept {
+    perf_counters_.Pause();
     DisableBenchmarkAllocator();
+    perf_counters_.Report(state_);
   }
+
+private:
+  benchmark::State &state_;
+  PerfCounters perf_counters_;
 };
 
+using AllocatorBenchmark = void (*)(benchmark::State &state, size_t backend);
+using BenchmarkConfiguration = void (*)(benchmark::internal::Benchmark *benchmark);
+
+// Whether a benchmark frees everything it allocated at the top of every iteration, or carries a live set over them,
+// which only the backends reusing memory can run for as long as the benchmark needs
+enum class LiveSet { FREED_PER_ITERATION, CARRIED_OVER };
+
+// Registers the benchmark as NAME<BACKEND> for every backend available in this build
+inline bool RegisterForEachAllocator(const char *name, AllocatorBenchmark function, BenchmarkConfiguration configure,
+                                     LiveSet live_set = LiveSet::FREED_PER_ITERATION) {
+  for (size_t backend = 0; backend != GetBenchmarkBackendsCount(); ++backend) {
+    if (IsBenchmarkBackendAvailable(backend) && (live_set == LiveSet::FREED_PER_ITERATION || DoesBenchmarkBackendReuseMemory(backend))) {
+      const std::string benchmark_name = std::string{name} + "<" + GetBenchmarkBackendName(backend) + ">";
+      configure(benchmark::RegisterBenchmark(benchmark_name.c_str(), function, backend));
+    }
+  }
+  return true;
+}
+
+#define BENCHMARK_FOR_EACH_ALLOCATOR(FUNCTION, CONFIGURE, ...)                                                                                                 \
+  static const bool FUNCTION##_registered = RegisterForEachAllocator(#FUNCTION, FUNCTION, CONFIGURE __VA_OPT__(, ) __VA_ARGS__)
+
+inline void ContainerSizes(benchmark::internal::Benchmark *benchmark) {
+  benchmark->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+}
+
 #endif // BENCHMARKS_COMMON_H
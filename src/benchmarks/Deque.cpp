@@ -5,14 +5,13 @@
 #include <deque>
 #include <optional>
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void Deque_PushBack(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void Deque_PushBack(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::deque<int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->push_back(i);
@@ -20,17 +19,15 @@ static void Deque_PushBack(benchmark::State &state) {
   }
 }
 
-BENCHMARK(Deque_PushBack<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(Deque_PushBack<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(Deque_PushBack, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void Deque_PushBack_PopFront(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void Deque_PushBack_PopFront(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::deque<int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->push_back(i);
@@ -41,20 +38,18 @@ static void Deque_PushBack_PopFront(benchmark::State &state) {
   }
 }
 
-BENCHMARK(Deque_PushBack_PopFront<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(Deque_PushBack_PopFront<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(Deque_PushBack_PopFront, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void Deque_PopFront(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void Deque_PopFront(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::deque<int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->push_back(i);
     }
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     while (!container->empty()) {
       container->pop_front();
@@ -62,7 +57,6 @@ static void Deque_PopFront(benchmark::State &state) {
   }
 }
 
-BENCHMARK(Deque_PopFront<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(Deque_PopFront<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(Deque_PopFront, ContainerSizes);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+// Simple Allocator 2024
+#include "PerfCounters.h"
+#include "SimpleAllocator.h"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+
+// Instructions per call of the inlined SimpleAllocator fast paths, counted with BENCHMARK_PERF_COUNTERS=1 on Linux.
+// A benchmark fails once the count goes over its budget, so a change which bloats a fast path doesn't pass unnoticed.
+// Without the counters only the time is reported.
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = 256 * 1024 * 1024;
+constexpr size_t BATCH_SIZE = 1024;
+
+// Budgets per operation, including the loop around it: 38 instructions were measured for a slot hit with its free
+// and 26 for a cut on x86-64 with GCC 12, the rest is headroom for other compilers.
+constexpr double SLOT_HIT_BUDGET = 48.0;
+constexpr double BUMP_CUT_BUDGET = 32.0;
+
+class FastPathAllocator {
+public:
+  FastPathAllocator() noexcept
+    : buffer_(new uint8_t[BUFFER_SIZE]) {
+    Reset();
+  }
+
+  // A fresh allocator over the same buffer
+  void Reset() noexcept {
+    allocator_ = std::make_unique<SimpleAllocator>();
+    allocator_->Init(buffer_.get(), BUFFER_SIZE);
+  }
+
+  SimpleAllocator *operator->() noexcept {
+    return allocator_.get();
+  }
+
+private:
+  std::unique_ptr<uint8_t[]> buffer_;
+  std::unique_ptr<SimpleAllocator> allocator_;
+};
+
+void ReportInstructions(benchmark::State &state, const PerfCounters &perf_counters, size_t operations, double budget) {
+  perf_counters.Report(state);
+  const auto instructions = state.counters.find("instructions");
+  if (instructions == state.counters.end() || !operations) {
+    return;
+  }
+  const double per_operation = instructions->second.value / static_cast<double>(operations);
+  state.counters["instructions/op"] = per_operation;
+  if (per_operation > budget) {
+    state.SkipWithError("the fast path takes more instructions than its budget");
+  }
+}
+
+} // namespace
+
+// Allocate and Deallocate of a block which is always in its slot
+static void FastPath_SlotHit(benchmark::State &state) {
+  const auto size = static_cast<size_t>(state.range(0));
+  FastPathAllocator allocator;
+  std::vector<void *> pointers(BATCH_SIZE);
+  for (auto &ptr : pointers) {
+    ptr = allocator->Allocate(size);
+  }
+  // Keeps the blocks of the batch away from the end of the heap, where a free rolls the buffer back instead
+  benchmark::DoNotOptimize(allocator->Allocate(16));
+  for (void *ptr : pointers) {
+    allocator->Deallocate(ptr);
+  }
+
+  PerfCounters perf_counters;
+  size_t operations = 0;
+  for (auto _ : state) {
+    perf_counters.Resume();
+    for (auto &ptr : pointers) {
+      ptr = allocator->Allocate(size);
+    }
+    benchmark::DoNotOptimize(pointers.data());
+    for (void *ptr : pointers) {
+      allocator->Deallocate(ptr);
+    }
+    perf_counters.Pause();
+    operations += pointers.size();
+    benchmark::ClobberMemory();
+  }
+  ReportInstructions(state, perf_counters, operations, SLOT_HIT_BUDGET);
+  state.SetItemsProcessed(static_cast<int64_t>(operations));
+}
+
+// Allocate of a slot size from the untouched buffer
+static void FastPath_BumpCut(benchmark::State &state) {
+  const auto size = static_cast<size_t>(state.range(0));
+  FastPathAllocator allocator;
+  std::vector<void *> pointers(BATCH_SIZE);
+  for (auto &ptr : pointers) {
+    ptr = allocator->Allocate(size);
+  }
+
+  PerfCounters perf_counters;
+  size_t operations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    allocator.Reset();
+    state.ResumeTiming();
+    perf_counters.Resume();
+    for (auto &ptr : pointers) {
+      ptr = allocator->Allocate(size);
+    }
+    perf_counters.Pause();
+    benchmark::DoNotOptimize(pointers.data());
+    operations += pointers.size();
+  }
+  ReportInstructions(state, perf_counters, operations, BUMP_CUT_BUDGET);
+  state.SetItemsProcessed(static_cast<int64_t>(operations));
+}
+
+BENCHMARK(FastPath_SlotHit)->ArgName("size")->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(FastPath_BumpCut)->ArgName("size")->Arg(16)->Arg(256)->Arg(4096);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,352 @@
+// Simple Allocator 2024
+#include "CompactingSimpleAllocator.h"
+#include "HintedSimpleAllocator.h"
+#include "ProcessMemory.h"
+#include "SimpleAllocator.h"
+
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sys/mman.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEAP_SIZE = size_t{1} << 33;
+constexpr size_t ALLOCATIONS_PER_TICK = 4;
+constexpr size_t SAMPLES = 512;
+constexpr size_t PHASES = 16;
+constexpr size_t PAGE_SIZE = 4096;
+constexpr size_t MAX_HANDLES = size_t{1} << 22;
+constexpr size_t COMPACT_BUDGET_PER_TICK = 4096;
+
+enum HeapBackend { SIMPLE_ALLOCATOR, HINTED_SIMPLE_ALLOCATOR, COMPACTING_SIMPLE_ALLOCATOR, SYSTEM_MALLOC };
+
+constexpr const char *GetHeapBackendName(HeapBackend backend) noexcept {
+  return backend == SIMPLE_ALLOCATOR                ? "SIMPLE_ALLOCATOR"
+         : backend == HINTED_SIMPLE_ALLOCATOR       ? "HINTED_SIMPLE_ALLOCATOR"
+         : backend == COMPACTING_SIMPLE_ALLOCATOR ? "COMPACTING_SIMPLE_ALLOCATOR"
+                                                    : "SYSTEM_MALLOC";
+}
+
+void TouchPages(void *ptr, size_t size) noexcept {
+  auto *bytes = static_cast<volatile uint8_t *>(ptr);
+  for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+    bytes[offset] = 1;
+  }
+  bytes[size - 1] = 1;
+}
+
+template<HeapBackend BACKEND>
+class ChurnHeap;
+
+template<>
+class ChurnHeap<SIMPLE_ALLOCATOR> {
+public:
+  ChurnHeap() noexcept
+    : buffer_(mmap(nullptr, HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))
+    , allocator_(std::make_unique<SimpleAllocator>()) {
+    if (buffer_ != MAP_FAILED) {
+      allocator_->Init(buffer_, HEAP_SIZE);
+    }
+  }
+
+  void *Allocate(size_t size, AllocationHint) noexcept {
+    return allocator_->Allocate(size);
+  }
+
+  void Deallocate(void *ptr) noexcept {
+    allocator_->Deallocate(ptr);
+  }
+
+  size_t HeapSize() const noexcept {
+    return allocator_->HeapExtent();
+  }
+
+  ~ChurnHeap() noexcept {
+    if (buffer_ != MAP_FAILED) {
+      munmap(buffer_, HEAP_SIZE);
+    }
+  }
+
+private:
+  void *buffer_{nullptr};
+  std::unique_ptr<SimpleAllocator> allocator_;
+};
+
+template<>
+class ChurnHeap<HINTED_SIMPLE_ALLOCATOR> {
+public:
+  ChurnHeap() noexcept
+    : buffer_(mmap(nullptr, HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))
+    , allocator_(std::make_unique<HintedSimpleAllocator>()) {
+    if (buffer_ != MAP_FAILED) {
+      allocator_->Init(buffer_, HEAP_SIZE);
+    }
+  }
+
+  void *Allocate(size_t size, AllocationHint hint) noexcept {
+    return allocator_->Allocate(size, hint);
+  }
+
+  void Deallocate(void *ptr) noexcept {
+    allocator_->Deallocate(ptr);
+  }
+
+  size_t HeapSize() const noexcept {
+    return allocator_->HeapExtent();
+  }
+
+  ~ChurnHeap() noexcept {
+    if (buffer_ != MAP_FAILED) {
+      munmap(buffer_, HEAP_SIZE);
+    }
+  }
+
+private:
+  void *buffer_{nullptr};
+  std::unique_ptr<HintedSimpleAllocator> allocator_;
+};
+
+// The pointers are handles, the memory is touched at allocation while pinned and compacted a step per tick
+template<>
+class ChurnHeap<COMPACTING_SIMPLE_ALLOCATOR> {
+public:
+  ChurnHeap() noexcept
+    : buffer_(mmap(nullptr, HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0))
+    , allocator_(std::make_unique<CompactingSimpleAllocator>()) {
+    if (buffer_ != MAP_FAILED) {
+      allocator_->Init(buffer_, HEAP_SIZE, MAX_HANDLES);
+    }
+  }
+
+  void *Allocate(size_t size, AllocationHint) noexcept {
+    const Handle handle = allocator_->Allocate(size);
+    if (!handle) {
+      return nullptr;
+    }
+    TouchPages(allocator_->Pin(handle), size);
+    allocator_->Unpin(handle);
+    return reinterpret_cast<void *>(uintptr_t{handle.index});
+  }
+
+  void Deallocate(void *ptr) noexcept {
+    allocator_->Deallocate({static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr))});
+  }
+
+  void Compact() noexcept {
+    allocator_->Compact(COMPACT_BUDGET_PER_TICK);
+  }
+
+  size_t HeapSize() const noexcept {
+    return allocator_->HeapExtent();
+  }
+
+  ~ChurnHeap() noexcept {
+    if (buffer_ != MAP_FAILED) {
+      munmap(buffer_, HEAP_SIZE);
+    }
+  }
+
+private:
+  void *buffer_{nullptr};
+  std::unique_ptr<CompactingSimpleAllocator> allocator_;
+};
+
+template<>
+class ChurnHeap<SYSTEM_MALLOC> {
+public:
+  ChurnHeap() noexcept {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+  }
+
+  void *Allocate(size_t size, AllocationHint) noexcept {
+    return std::malloc(size);
+  }
+
+  void Deallocate(void *ptr) noexcept {
+    std::free(ptr);
+  }
+
+  size_t HeapSize() const noexcept {
+    return SystemMallocHeapSize();
+  }
+};
+
+struct LiveObject {
+  uint64_t death_tick;
+  void *ptr;
+  size_t size;
+
+  bool operator>(const LiveObject &other) const noexcept {
+    return death_tick > other.death_tick;
+  }
+};
+
+// Object sizes are log-uniform within the phase range, so every slot class and the tree get their share
+struct SizeMix {
+  double min_size;
+  double max_size;
+
+  size_t operator()(std::mt19937_64 &generator) const {
+    std::uniform_real_distribution<double> log_size{std::log(min_size), std::log(max_size)};
+    return static_cast<size_t>(std::exp(log_size(generator)));
+  }
+};
+
+constexpr std::array<SizeMix, 4> SIZE_MIXES{{
+  {16, 256},               // strings and container nodes
+  {256, 16 * 1024},        // medium buffers served by slots
+  {16 * 1024, 256 * 1024}, // large buffers served by the tree
+  {16, 64 * 1024},         // everything at once
+}};
+
+struct Lifetime {
+  uint64_t ticks;
+  AllocationHint hint;
+};
+
+// Most objects die young, some survive a phase, a few pin their memory for the rest of the run.
+// The hint is what the caller would know: whether the object is temporary.
+// The bulk hint isn't used, separating big buffers from the rest costs more reuse than it saves here.
+Lifetime PickLifetime(std::mt19937_64 &generator, uint64_t ticks) {
+  const double kind = std::uniform_real_distribution<double>{0.0, 1.0}(generator);
+  const double mean_lifetime = kind < 0.80 ? 64.0 : kind < 0.98 ? 4096.0 : static_cast<double>(ticks) / 2.0;
+  const AllocationHint hint = kind < 0.80 ? AllocationHint::SHORT_LIVED : AllocationHint::LONG_LIVED;
+  return {1 + static_cast<uint64_t>(std::exponential_distribution<double>{1.0 / mean_lifetime}(generator)), hint};
+}
+
+
+struct ChurnStats {
+  size_t peak_live_bytes{0};
+  size_t peak_heap_bytes{0};
+  size_t peak_rss_bytes{0};
+  double peak_fragmentation{0.0};
+  double final_fragmentation{0.0};
+};
+
+// Appends the samples to $FRAGMENTATION_SAMPLES_CSV if it is set, to plot them over time
+class SamplesWriter {
+public:
+  explicit SamplesWriter(const char *backend_name) noexcept
+    : backend_name_(backend_name) {
+    if (const char *path = std::getenv("FRAGMENTATION_SAMPLES_CSV")) {
+      file_ = std::fopen(path, "a");
+    }
+  }
+
+  void Write(uint64_t tick, size_t live_bytes, size_t heap_bytes, size_t rss_bytes) noexcept {
+    if (file_) {
+      std::fprintf(file_, "%s,%llu,%zu,%zu,%zu\n", backend_name_, static_cast<unsigned long long>(tick), live_bytes, heap_bytes, rss_bytes);
+    }
+  }
+
+  ~SamplesWriter() noexcept {
+    if (file_) {
+      std::fclose(file_);
+    }
+  }
+
+private:
+  const char *backend_name_;
+  FILE *file_{nullptr};
+};
+
+template<HeapBackend BACKEND>
+bool RunChurn(ChurnHeap<BACKEND> &heap, uint64_t ticks, ChurnStats &stats) {
+  SamplesWriter samples_writer{GetHeapBackendName(BACKEND)};
+  std::mt19937_64 generator{2024};
+  std::vector<LiveObject> storage;
+  storage.reserve(ticks / 8);
+  std::priority_queue<LiveObject, std::vector<LiveObject>, std::greater<>> live_objects{std::greater<>{}, std::move(storage)};
+
+  const size_t heap_before = heap.HeapSize();
+  const size_t rss_before = CurrentRss();
+  const uint64_t sample_period = std::max<uint64_t>(ticks / SAMPLES, 1);
+  const uint64_t phase_length = std::max<uint64_t>(ticks / PHASES, 1);
+  size_t live_bytes = 0;
+  bool succeeded = true;
+  for (uint64_t tick = 0; tick != ticks && succeeded; ++tick) {
+    while (!live_objects.empty() && live_objects.top().death_tick <= tick) {
+      heap.Deallocate(live_objects.top().ptr);
+      live_bytes -= live_objects.top().size;
+      live_objects.pop();
+    }
+
+    const SizeMix &size_mix = SIZE_MIXES[(tick / phase_length) % SIZE_MIXES.size()];
+    for (size_t i = 0; i != ALLOCATIONS_PER_TICK; ++i) {
+      const size_t size = size_mix(generator);
+      const Lifetime lifetime = PickLifetime(generator, ticks);
+      void *ptr = heap.Allocate(size, lifetime.hint);
+      if (!ptr) {
+        succeeded = false;
+        break;
+      }
+      if constexpr (BACKEND != COMPACTING_SIMPLE_ALLOCATOR) {
+        TouchPages(ptr, size);
+      }
+      live_bytes += size;
+      live_objects.push({tick + lifetime.ticks, ptr, size});
+    }
+
+    if constexpr (BACKEND == COMPACTING_SIMPLE_ALLOCATOR) {
+      heap.Compact();
+    }
+
+    if (tick % sample_period == 0 && live_bytes) {
+      const size_t heap_bytes = heap.HeapSize() - heap_before;
+      const size_t rss_bytes = CurrentRss() - rss_before;
+      const double fragmentation = static_cast<double>(heap_bytes) / static_cast<double>(live_bytes);
+      samples_writer.Write(tick, live_bytes, heap_bytes, rss_bytes);
+      stats.peak_live_bytes = std::max(stats.peak_live_bytes, live_bytes);
+      stats.peak_heap_bytes = std::max(stats.peak_heap_bytes, heap_bytes);
+      stats.peak_rss_bytes = std::max(stats.peak_rss_bytes, rss_bytes);
+      stats.peak_fragmentation = std::max(stats.peak_fragmentation, fragmentation);
+      stats.final_fragmentation = fragmentation;
+    }
+  }
+
+  for (; !live_objects.empty(); live_objects.pop()) {
+    heap.Deallocate(live_objects.top().ptr);
+  }
+  return succeeded;
+}
+
+} // namespace
+
+// Compresses a long service lifetime: size mixes shift every phase, lifetimes span from a few ticks to the whole run.
+// Heap is the memory the allocator took for itself (current_ - buffer_begin_ for SimpleAllocator), fragmentation is heap / live.
+template<HeapBackend BACKEND>
+static void Fragmentation_Churn(benchmark::State &state) {
+  ChurnStats stats;
+  for (auto _ : state) {
+    ChurnHeap<BACKEND> heap;
+    if (!RunChurn(heap, static_cast<uint64_t>(state.range(0)), stats)) {
+      state.SkipWithError("out of memory");
+      return;
+    }
+  }
+
+  state.counters["live_peak"] = benchmark::Counter(static_cast<double>(stats.peak_live_bytes), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["heap_peak"] = benchmark::Counter(static_cast<double>(stats.peak_heap_bytes), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["rss_peak"] = benchmark::Counter(static_cast<double>(stats.peak_rss_bytes), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["frag_peak"] = stats.peak_fragmentation;
+  state.counters["frag_final"] = stats.final_fragmentation;
+  state.counters["rss_overhead"] = static_cast<double>(stats.peak_rss_bytes) / static_cast<double>(std::max<size_t>(stats.peak_live_bytes, 1));
+}
+
+BENCHMARK(Fragmentation_Churn<SIMPLE_ALLOCATOR>)->Arg(1 << 20)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(Fragmentation_Churn<HINTED_SIMPLE_ALLOCATOR>)->Arg(1 << 20)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(Fragmentation_Churn<COMPACTING_SIMPLE_ALLOCATOR>)->Arg(1 << 20)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(Fragmentation_Churn<SYSTEM_MALLOC>)->Arg(1 << 20)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
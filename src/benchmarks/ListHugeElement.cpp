@@ -6,14 +6,13 @@
 #include <optional>
 #include <string>
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void ListHugeElement_PushBack(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void ListHugeElement_PushBack(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::list<std::string>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     std::string huge_element(1024 * 16 + 1, 'a');
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
@@ -25,17 +24,15 @@ static void ListHugeElement_PushBack(benchmark::State &state) {
   }
 }
 
-BENCHMARK(ListHugeElement_PushBack<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(ListHugeElement_PushBack<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(ListHugeElement_PushBack, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void ListHugeElement_PushBack_PopFront(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void ListHugeElement_PushBack_PopFront(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::list<std::string>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     std::string huge_element(1024 * 16 + 1, 'a');
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
@@ -50,15 +47,13 @@ static void ListHugeElement_PushBack_PopFront(benchmark::State &state) {
   }
 }
 
-BENCHMARK(ListHugeElement_PushBack_PopFront<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(ListHugeElement_PushBack_PopFront<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(ListHugeElement_PushBack_PopFront, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void ListHugeElement_PopFront(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void ListHugeElement_PopFront(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::list<std::string>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
     std::string huge_element(1024 * 16 + 1, 'a');
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
@@ -67,7 +62,7 @@ static void ListHugeElement_PopFront(benchmark::State &state) {
       }
       container->push_back(huge_element);
     }
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     while (!container->empty()) {
       container->pop_front();
@@ -75,7 +70,6 @@ static void ListHugeElement_PopFront(benchmark::State &state) {
   }
 }
 
-BENCHMARK(ListHugeElement_PopFront<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(ListHugeElement_PopFront<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(ListHugeElement_PopFront, ContainerSizes);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,158 @@
+// Simple Allocator 2024
+#include "Common.h"
+#include "ObjectPool.h"
+
+#include <benchmark/benchmark.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+
+namespace {
+
+// Container allocator which takes single nodes from an ObjectPool and arrays straight from the SimpleAllocator.
+// Copies share the pool, rebinding creates a pool for the new type.
+template<class T>
+class ObjectPoolAllocator {
+public:
+  using value_type = T;
+
+  explicit ObjectPoolAllocator(SimpleAllocator &allocator)
+    : allocator_(&allocator)
+    , pool_(std::make_shared<ObjectPool<T>>(allocator)) {}
+
+  template<class U>
+  ObjectPoolAllocator(const ObjectPoolAllocator<U> &other)
+    : ObjectPoolAllocator(*other.allocator_) {}
+
+  T *allocate(size_t n) {
+    void *memory = n == 1 ? pool_->Allocate() : allocator_->Allocate(n * sizeof(T));
+    if (!memory) {
+      throw std::bad_alloc{};
+    }
+    return static_cast<T *>(memory);
+  }
+
+  void deallocate(T *ptr, size_t n) noexcept {
+    if (n == 1) {
+      pool_->Deallocate(ptr);
+    } else {
+      allocator_->Deallocate(ptr);
+    }
+  }
+
+  friend bool operator==(const ObjectPoolAllocator &left, const ObjectPoolAllocator &right) noexcept {
+    return left.pool_ == right.pool_;
+  }
+
+private:
+  template<class U>
+  friend class ObjectPoolAllocator;
+
+  SimpleAllocator *allocator_;
+  std::shared_ptr<ObjectPool<T>> pool_;
+};
+
+// Allocated from the replacement library, so it has to fit into its system heap
+class PoolHeap {
+public:
+  PoolHeap() noexcept {
+    allocator_.Init(buffer_.get(), BUFFER_SIZE);
+  }
+
+  SimpleAllocator &Allocator() noexcept {
+    return allocator_;
+  }
+
+private:
+  static constexpr size_t BUFFER_SIZE = 64 * 1024 * 1024;
+
+  std::unique_ptr<uint8_t[]> buffer_{new uint8_t[BUFFER_SIZE]};
+  SimpleAllocator allocator_;
+};
+
+using PooledList = std::list<int64_t, ObjectPoolAllocator<int64_t>>;
+using PooledMap = std::map<int64_t, int64_t, std::less<>, ObjectPoolAllocator<std::pair<const int64_t, int64_t>>>;
+
+} // namespace
+
+static void NodeAllocation_List(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
+  std::optional<std::list<int64_t>> container;
+  for (auto _ : state) {
+    malloc_replacement.PauseTiming();
+    container.emplace();
+    malloc_replacement.ResumeTiming();
+
+    for (int64_t i = 0, size = state.range(0); i != size; ++i) {
+      container->push_back(i);
+      if (i % 2) {
+        container->pop_front();
+      }
+    }
+  }
+}
+
+BENCHMARK_FOR_EACH_ALLOCATOR(NodeAllocation_List, ContainerSizes);
+
+static void NodeAllocation_ListObjectPool(benchmark::State &state) {
+  PoolHeap heap;
+  std::optional<PooledList> container;
+  for (auto _ : state) {
+    state.PauseTiming();
+    container.reset();
+    container.emplace(ObjectPoolAllocator<int64_t>{heap.Allocator()});
+    state.ResumeTiming();
+
+    for (int64_t i = 0, size = state.range(0); i != size; ++i) {
+      container->push_back(i);
+      if (i % 2) {
+        container->pop_front();
+      }
+    }
+  }
+}
+
+BENCHMARK(NodeAllocation_ListObjectPool)->Name("NodeAllocation_List<OBJECT_POOL>")->Apply(ContainerSizes);
+
+static void NodeAllocation_Map(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
+  std::optional<std::map<int64_t, int64_t>> container;
+  for (auto _ : state) {
+    malloc_replacement.PauseTiming();
+    container.emplace();
+    malloc_replacement.ResumeTiming();
+
+    for (int64_t i = 0, size = state.range(0); i != size; ++i) {
+      container->insert({i, i});
+      if (i % 2) {
+        container->erase(container->begin());
+      }
+    }
+  }
+}
+
+BENCHMARK_FOR_EACH_ALLOCATOR(NodeAllocation_Map, ContainerSizes);
+
+static void NodeAllocation_MapObjectPool(benchmark::State &state) {
+  PoolHeap heap;
+  std::optional<PooledMap> container;
+  for (auto _ : state) {
+    state.PauseTiming();
+    container.reset();
+    container.emplace(ObjectPoolAllocator<std::pair<const int64_t, int64_t>>{heap.Allocator()});
+    state.ResumeTiming();
+
+    for (int64_t i = 0, size = state.range(0); i != size; ++i) {
+      container->insert({i, i});
+      if (i % 2) {
+        container->erase(container->begin());
+      }
+    }
+  }
+}
+
+BENCHMARK(NodeAllocation_MapObjectPool)->Name("NodeAllocation_Map<OBJECT_POOL>")->Apply(ContainerSizes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,51 @@
+// Simple Allocator 2024
+#include "PerCpuSimpleAllocator.h"
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEAP_SIZE = size_t{1} << 28;
+constexpr size_t WORKING_SET = 64;
+
+enum CacheMode { LOCKED, RSEQ };
+
+// One heap for all threads of a run, kept across the runs of a mode
+template<CacheMode MODE>
+PerCpuSimpleAllocator &GetAllocator() {
+  static auto buffer = std::make_unique<uint8_t[]>(HEAP_SIZE);
+  static PerCpuSimpleAllocator allocator;
+  static const bool initialized = allocator.Init(buffer.get(), HEAP_SIZE, MODE == RSEQ);
+  (void)initialized;
+  return allocator;
+}
+
+} // namespace
+
+// Every thread churns a working set of small objects, each allocation written once.
+// LOCKED takes the spin lock on every call, RSEQ stays in the cache of its CPU but for the batches of a refill or a drain.
+template<CacheMode MODE>
+static void PerCpu_Churn(benchmark::State &state) {
+  PerCpuSimpleAllocator &allocator = GetAllocator<MODE>();
+  std::vector<void *> pointers(WORKING_SET);
+  size_t i = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    const size_t index = i++ % WORKING_SET;
+    allocator.Deallocate(pointers[index]);
+    const size_t size = 16 + index % 8 * 24;
+    pointers[index] = allocator.Allocate(size);
+    std::memset(pointers[index], 1, size);
+  }
+  for (void *pointer : pointers) {
+    allocator.Deallocate(pointer);
+  }
+  state.counters["cpu_caches"] = benchmark::Counter(allocator.UsesCpuCaches(), benchmark::Counter::kAvgThreads);
+}
+
+BENCHMARK(PerCpu_Churn<LOCKED>)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(PerCpu_Churn<RSEQ>)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,131 @@
+// Simple Allocator 2024
+#ifndef BENCHMARKS_PERFCOUNTERS_H
+#define BENCHMARKS_PERFCOUNTERS_H
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters of the benchmark thread, reported per iteration as user counters.
+// Opt-in with BENCHMARK_PERF_COUNTERS=1, every event which can't be opened (no PMU, perf_event_paranoid, not Linux) is skipped.
+class PerfCounters {
+public:
+  PerfCounters() noexcept {
+#ifdef __linux__
+    fds_.fill(-1);
+    if (!std::getenv("BENCHMARK_PERF_COUNTERS")) {
+      return;
+    }
+
+    bool any_opened = false;
+    for (size_t i = 0; i != EVENTS.size(); ++i) {
+      fds_[i] = Open(EVENTS[i]);
+      any_opened |= fds_[i] != -1;
+    }
+
+    static bool warned = false;
+    if (!any_opened && !warned) {
+      warned = true;
+      std::fprintf(stderr, "perf counters are unavailable, check /proc/sys/kernel/perf_event_paranoid\n");
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  void Resume() noexcept {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  void Pause() noexcept {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+#endif
+  }
+
+  void Report(benchmark::State &state) const noexcept {
+#ifdef __linux__
+    for (size_t i = 0; i != EVENTS.size(); ++i) {
+      if (fds_[i] == -1) {
+        continue;
+      }
+      // The kernel multiplexes events when there are more of them than hardware counters, so the value is scaled
+      struct {
+        uint64_t value;
+        uint64_t time_enabled;
+        uint64_t time_running;
+      } reading{};
+      if (read(fds_[i], &reading, sizeof(reading)) == sizeof(reading) && reading.time_running) {
+        const double value = static_cast<double>(reading.value) * static_cast<double>(reading.time_enabled) / static_cast<double>(reading.time_running);
+        state.counters[EVENTS[i].name] = benchmark::Counter(value, benchmark::Counter::kAvgIterations);
+      }
+    }
+#else
+    (void)state;
+#endif
+  }
+
+  ~PerfCounters() noexcept {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+private:
+#ifdef __linux__
+  struct Event {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  // Cache events are encoded as cache | (operation << 8) | (result << 16)
+  static constexpr std::array<Event, 6> EVENTS{{
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"llc_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  }};
+
+  static int Open(const Event &event) noexcept {
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = event.type;
+    attributes.config = event.config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+  }
+
+  std::array<int, EVENTS.size()> fds_;
+#endif
+};
+
+#endif // BENCHMARKS_PERFCOUNTERS_H
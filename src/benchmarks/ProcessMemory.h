@@ -0,0 +1,58 @@
+// Simple Allocator 2024
+#ifndef BENCHMARKS_PROCESSMEMORY_H
+#define BENCHMARKS_PROCESSMEMORY_H
+#include <cstddef>
+#include <cstdio>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+// Resident set size of the current process in bytes, 0 if unknown.
+inline size_t CurrentRss() noexcept {
+#ifdef __APPLE__
+  mach_task_basic_info info{};
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#else
+  size_t total_pages = 0;
+  size_t resident_pages = 0;
+  FILE *statm = std::fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  const bool parsed = std::fscanf(statm, "%zu %zu", &total_pages, &resident_pages) == 2;
+  std::fclose(statm);
+  return parsed ? resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+// Bytes the system malloc holds from the OS, including its free memory, 0 if unknown.
+inline size_t SystemMallocHeapSize() noexcept {
+#ifdef __APPLE__
+  return mstats().bytes_total;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  const auto info = mallinfo2();
+  return info.arena + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+// Returns the free memory of the system malloc to the OS, so it doesn't hide the growth of the next measured heap.
+inline void TrimSystemMalloc() noexcept {
+#ifdef __APPLE__
+  malloc_zone_pressure_relief(nullptr, 0);
+#elif defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+
+#endif // BENCHMARKS_PROCESSMEMORY_H
@@ -0,0 +1,167 @@
+// Simple Allocator 2024
+#include "Common.h"
+#include "ProcessMemory.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A server request lifecycle: parse a message into strings and maps, build a response in a growing string and vector,
+// keep some of the results in a cache with random eviction and free everything else.
+
+namespace {
+
+constexpr size_t MESSAGES = 64;
+constexpr size_t REQUESTS_PER_ITERATION = 256;
+
+// Raw requests in the shape of "METHOD /path\nName: value\n...\n\nkey=value&key=value...", made with the system heap
+std::vector<std::string> MakeMessages() {
+  std::mt19937_64 generator{11};
+  std::lognormal_distribution<double> value_length{std::log(24.0), 1.0};
+  std::uniform_int_distribution<size_t> headers{4, 16};
+  std::uniform_int_distribution<size_t> params{2, 32};
+  const auto make_value = [&] { return std::string(std::clamp<size_t>(static_cast<size_t>(value_length(generator)), 1, 2048), 'v'); };
+
+  std::vector<std::string> messages;
+  for (size_t m = 0; m != MESSAGES; ++m) {
+    std::string message = m % 3 ? "GET /api/v1/items/" : "POST /api/v1/orders/";
+    message += std::to_string(generator() % 100000);
+    message += "\n";
+    for (size_t h = 0, count = headers(generator); h != count; ++h) {
+      message += "X-Header-" + std::to_string(h) + ": " + make_value() + "\n";
+    }
+    message += "\n";
+    for (size_t p = 0, count = params(generator); p != count; ++p) {
+      message += (p ? "&param_" : "param_") + std::to_string(p) + "=" + make_value();
+    }
+    messages.push_back(std::move(message));
+  }
+  return messages;
+}
+
+struct Request {
+  std::string method;
+  std::string path;
+  std::unordered_map<std::string, std::string> headers;
+  std::map<std::string, std::string> params;
+};
+
+struct CachedResponse {
+  std::string body;
+  std::map<std::string, std::string> params;
+};
+
+Request Parse(std::string_view message) {
+  Request request;
+  size_t line_end = message.find('\n');
+  std::string_view line = message.substr(0, line_end);
+  const size_t space = line.find(' ');
+  request.method = line.substr(0, space);
+  request.path = line.substr(space + 1);
+
+  for (size_t begin = line_end + 1; (line_end = message.find('\n', begin)) != begin; begin = line_end + 1) {
+    line = message.substr(begin, line_end - begin);
+    const size_t colon = line.find(": ");
+    request.headers.emplace(line.substr(0, colon), line.substr(colon + 2));
+  }
+
+  for (size_t begin = line_end + 1; begin < message.size();) {
+    const size_t end = std::min(message.find('&', begin), message.size());
+    const std::string_view param = message.substr(begin, end - begin);
+    const size_t equals = param.find('=');
+    request.params.emplace(param.substr(0, equals), param.substr(equals + 1));
+    begin = end + 1;
+  }
+  return request;
+}
+
+std::string BuildResponse(const Request &request) {
+  std::vector<std::string> fields;
+  for (const auto &[key, value] : request.params) {
+    fields.push_back("\"" + key + "\": \"" + value + "\"");
+  }
+  std::string body = "{\"path\": \"" + request.path + "\", \"headers\": " + std::to_string(request.headers.size());
+  for (const auto &field : fields) {
+    body += ", ";
+    body += field;
+  }
+  body += "}";
+  return body;
+}
+
+// Keeps at most capacity responses, a random one leaves for every new one over it
+class ResponseCache {
+public:
+  explicit ResponseCache(size_t capacity)
+    : capacity_(capacity) {}
+
+  void Insert(std::string key, std::shared_ptr<const CachedResponse> response, std::mt19937_64 &generator) {
+    if (entries_.size() >= capacity_) {
+      const size_t evicted = generator() % keys_.size();
+      entries_.erase(keys_[evicted]);
+      keys_[evicted] = std::move(keys_.back());
+      keys_.pop_back();
+    }
+    if (entries_.insert_or_assign(key, std::move(response)).second) {
+      keys_.push_back(std::move(key));
+    }
+  }
+
+private:
+  size_t capacity_;
+  std::unordered_map<std::string, std::shared_ptr<const CachedResponse>> entries_;
+  std::vector<std::string> keys_;
+};
+
+} // namespace
+
+static void Request_Lifecycle(benchmark::State &state, size_t allocator) {
+  const std::vector<std::string> messages = MakeMessages();
+  TrimSystemMalloc();
+  const size_t start_rss = CurrentRss();
+  size_t peak_rss = start_rss;
+  size_t requests = 0;
+  {
+    ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
+    std::mt19937_64 generator{5};
+    // Destroyed before the replacement, with the benchmark heap still in place
+    ResponseCache cache{static_cast<size_t>(state.range(0))};
+    for (auto _ : state) {
+      for (size_t i = 0; i != REQUESTS_PER_ITERATION; ++i) {
+        Request request = Parse(messages[generator() % messages.size()]);
+        std::string response = BuildResponse(request);
+        benchmark::DoNotOptimize(response.data());
+        // Every fourth response is cached along with its parameters, the rest of the request dies here
+        if (generator() % 4 == 0) {
+          auto cached = std::make_shared<const CachedResponse>(CachedResponse{std::move(response), std::move(request.params)});
+          cache.Insert(request.path + "#" + std::to_string(generator() % 65536), std::move(cached), generator);
+        }
+      }
+      requests += REQUESTS_PER_ITERATION;
+
+      malloc_replacement.PauseTiming();
+      peak_rss = std::max(peak_rss, CurrentRss());
+      malloc_replacement.ResumeTiming();
+    }
+  }
+
+  state.counters["requests"] = benchmark::Counter(static_cast<double>(requests), benchmark::Counter::kIsRate);
+  // Growth of the resident set over the start of the benchmark, the free memory of the system malloc is trimmed before
+  state.counters["peak_heap"] = benchmark::Counter(static_cast<double>(peak_rss - start_rss), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+static void CacheSizes(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("cache")->Arg(1 << 10)->Arg(1 << 14);
+}
+
+// The cache lives over the iterations
+BENCHMARK_FOR_EACH_ALLOCATOR(Request_Lifecycle, CacheSizes, LiveSet::CARRIED_OVER);
+
+BENCHMARK_MAIN();
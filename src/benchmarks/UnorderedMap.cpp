@@ -5,14 +5,13 @@
 #include <optional>
 #include <unordered_map>
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void UnorderedMap_Insert(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void UnorderedMap_Insert(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::unordered_map<int64_t, int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->insert({i, i});
@@ -20,20 +19,18 @@ static void UnorderedMap_Insert(benchmark::State &state) {
   }
 }
 
-BENCHMARK(UnorderedMap_Insert<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(UnorderedMap_Insert<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(UnorderedMap_Insert, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void UnorderedMap_Erase(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void UnorderedMap_Erase(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::unordered_map<int64_t, int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->insert({i, i});
     }
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     while (!container->empty()) {
       container->erase(container->begin());
@@ -41,17 +38,15 @@ static void UnorderedMap_Erase(benchmark::State &state) {
   }
 }
 
-BENCHMARK(UnorderedMap_Erase<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(UnorderedMap_Erase<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(UnorderedMap_Erase, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void UnorderedMap_InsertErase(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void UnorderedMap_InsertErase(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::unordered_map<int64_t, int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->insert({i, i});
@@ -62,20 +57,18 @@ static void UnorderedMap_InsertErase(benchmark::State &state) {
   }
 }
 
-BENCHMARK(UnorderedMap_InsertErase<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(UnorderedMap_InsertErase<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(UnorderedMap_InsertErase, ContainerSizes);
 
-template<AllocatorType ALLOCATOR_TYPE>
-static void UnorderedMap_Find(benchmark::State &state) {
-  ScopedBenchmarkAllocatorReplacement<ALLOCATOR_TYPE> malloc_replacement;
+static void UnorderedMap_Find(benchmark::State &state, size_t allocator) {
+  ScopedBenchmarkAllocatorReplacement malloc_replacement{state, allocator};
   std::optional<std::unordered_map<int64_t, int64_t>> container;
   for (auto _ : state) {
-    state.PauseTiming();
+    malloc_replacement.PauseTiming();
     container.emplace();
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
       container->insert({i, i});
     }
-    state.ResumeTiming();
+    malloc_replacement.ResumeTiming();
 
     uint64_t sum = 0;
     for (int64_t i = 0, size = state.range(0); i != size; ++i) {
@@ -86,7 +79,6 @@ static void UnorderedMap_Find(benchmark::State &state) {
   }
 }
 
-BENCHMARK(UnorderedMap_Find<SIMPLE_ALLOCATOR>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
-BENCHMARK(UnorderedMap_Find<VANILLA_MALLOC>)->RangeMultiplier(2)->Range(1 << 10, 1 << 15);
+BENCHMARK_FOR_EACH_ALLOCATOR(UnorderedMap_Find, ContainerSizes);
 
 BENCHMARK_MAIN();
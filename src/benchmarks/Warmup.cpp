@@ -0,0 +1,110 @@
+// Simple Allocator 2024
+#include "CycleCounter.h"
+#include "SimpleAllocator.h"
+
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sys/mman.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEAP_SIZE = size_t{1} << 28;
+constexpr std::array<size_t, 6> SIZES{32, 64, 128, 256, 1024, 4096};
+
+enum HeapState { COLD, WARM };
+
+// The first operations of a service: mostly allocations of a few object sizes, each written right away, some freed again
+struct Operation {
+  size_t size;
+  size_t freed;
+};
+
+std::vector<Operation> MakeOperations(size_t count) {
+  std::mt19937_64 generator{45};
+  std::vector<Operation> operations;
+  for (size_t i = 0; i != count; ++i) {
+    operations.push_back({SIZES[generator() % SIZES.size()], i && generator() % 4 == 0 ? generator() % i : SIZE_MAX});
+  }
+  return operations;
+}
+
+// Enough blocks of every size for the operations and the bytes they cut from the buffer
+struct Profile {
+  explicit Profile(const std::vector<Operation> &operations) noexcept {
+    for (size_t i = 0; i != SIZES.size(); ++i) {
+      slot_blocks[i].size = SIZES[i];
+    }
+    for (const Operation &operation : operations) {
+      ++std::find_if(slot_blocks.begin(), slot_blocks.end(), [&operation](const auto &blocks) { return blocks.size == operation.size; })->count;
+      prefault_size += sizeof(MemoryBlock) + operation.size;
+    }
+  }
+
+  std::array<WarmupProfile::SlotBlocks, SIZES.size()> slot_blocks{};
+  size_t prefault_size{0};
+};
+
+} // namespace
+
+// Cycles of the first operations on a fresh heap, each allocation with the first write to its memory where the page faults land.
+// COLD starts from an untouched buffer, WARM calls Warmup with a profile of the same operations first, outside of the timing.
+template<HeapState STATE>
+static void Warmup_FirstOperations(benchmark::State &state) {
+  const std::vector<Operation> operations = MakeOperations(static_cast<size_t>(state.range(0)));
+  const Profile profile{operations};
+  std::vector<void *> pointers(operations.size());
+  std::vector<uint64_t> cycles;
+  cycles.reserve(operations.size() * 64);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    void *buffer = mmap(nullptr, HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (buffer == MAP_FAILED) {
+      state.SkipWithError("mmap failed");
+      return;
+    }
+    auto allocator = std::make_unique<SimpleAllocator>();
+    allocator->Init(buffer, HEAP_SIZE);
+    if (STATE == WARM && !allocator->Warmup({profile.prefault_size, profile.slot_blocks})) {
+      state.SkipWithError("warmup failed");
+      return;
+    }
+    state.ResumeTiming();
+
+    for (size_t i = 0; i != operations.size(); ++i) {
+      const uint64_t start = ReadCycleCounter();
+      pointers[i] = allocator->Allocate(operations[i].size);
+      std::memset(pointers[i], 1, operations[i].size);
+      if (operations[i].freed != SIZE_MAX && pointers[operations[i].freed]) {
+        allocator->Deallocate(pointers[operations[i].freed]);
+        pointers[operations[i].freed] = nullptr;
+      }
+      cycles.push_back(ReadCycleCounter() - start);
+    }
+
+    state.PauseTiming();
+    allocator.reset();
+    munmap(buffer, HEAP_SIZE);
+    state.ResumeTiming();
+  }
+
+  std::sort(cycles.begin(), cycles.end());
+  uint64_t total = 0;
+  for (uint64_t operation_cycles : cycles) {
+    total += operation_cycles;
+  }
+  state.counters["cycles_mean"] = static_cast<double>(total) / static_cast<double>(std::max<size_t>(cycles.size(), 1));
+  state.counters["cycles_p50"] = static_cast<double>(cycles.empty() ? 0 : cycles[cycles.size() / 2]);
+  state.counters["cycles_p99"] = static_cast<double>(cycles.empty() ? 0 : cycles[cycles.size() * 99 / 100]);
+  state.counters["cycles_max"] = static_cast<double>(cycles.empty() ? 0 : cycles.back());
+}
+
+BENCHMARK(Warmup_FirstOperations<COLD>)->Arg(1024)->Arg(16 * 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK(Warmup_FirstOperations<WARM>)->Arg(1024)->Arg(16 * 1024)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+// Simple Allocator 2024
+#ifndef ADDRESSOWNERSHIPMAP_H
+#define ADDRESSOWNERSHIPMAP_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+enum class AddressOwner : uint8_t {
+  // Not reserved by this library: the system malloc or a backend without a reserved heap
+  FOREIGN,
+  // System heaps in the order of AllocationHint: long-lived, short-lived and bulk
+  SYSTEM_HEAP,
+  SYSTEM_SHORT_LIVED_HEAP,
+  SYSTEM_BULK_HEAP,
+  BENCHMARK_HEAP,
+  // Sampled allocations between guard pages
+  GUARDED_POOL,
+  // A recently stopped benchmark heap, its address range stays reserved but has no memory behind it
+  RELEASED_HEAP,
+};
+
+// Owner of every granule of the user address space in a flat table, so a lookup is a shift, a compare and a load.
+// Heaps reserve their regions through the map aligned to the granule, so a granule never has two owners.
+class AddressOwnershipMap {
+public:
+  static constexpr size_t GRANULE_SHIFT = 26;
+  static constexpr size_t GRANULE_SIZE = size_t{1} << GRANULE_SHIFT;
+  static constexpr size_t ADDRESS_BITS = 48;
+  // Released regions which stay reserved, the oldest one is unmapped when another is released
+  static constexpr size_t RETIRED_REGIONS = 4;
+
+  AddressOwner Lookup(const void *ptr) const noexcept {
+    const size_t granule = reinterpret_cast<uintptr_t>(ptr) >> GRANULE_SHIFT;
+    return granule < owners_.size() ? owners_[granule] : AddressOwner::FOREIGN;
+  }
+
+  // Maps a region of at least size bytes for the owner, nullptr if the address space is exhausted
+  void *MapRegion(size_t size, AddressOwner owner) noexcept {
+    size = AlignToGranule(size);
+    // Over-map by a granule and trim both ends to get the alignment
+    void *mapping = mmap(nullptr, size + GRANULE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      return nullptr;
+    }
+    auto *begin = static_cast<uint8_t *>(mapping);
+    auto *region = reinterpret_cast<uint8_t *>(AlignToGranule(reinterpret_cast<uintptr_t>(begin)));
+    if (region != begin) {
+      munmap(begin, static_cast<size_t>(region - begin));
+    }
+    if (const size_t tail = GRANULE_SIZE - static_cast<size_t>(region - begin)) {
+      munmap(region + size, tail);
+    }
+    Assign(region, size, owner);
+    return region;
+  }
+
+  // Gives the memory back to the OS, but keeps the range reserved: nothing else can be mapped there, so pointers into
+  // the released heap are still recognized. Only the last RETIRED_REGIONS stay reserved, so switching heaps doesn't
+  // use up the address space, the range of an older one is unmapped and foreign again.
+  void ReleaseRegion(void *region, size_t size) noexcept {
+    size = AlignToGranule(size);
+    mmap(region, size, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    Assign(region, size, AddressOwner::RELEASED_HEAP);
+
+    Region &retired = retired_regions_[retired_count_++ % RETIRED_REGIONS];
+    if (retired.begin) {
+      munmap(retired.begin, retired.size);
+      Assign(retired.begin, retired.size, AddressOwner::FOREIGN);
+    }
+    retired = {region, size};
+  }
+
+private:
+  static constexpr size_t AlignToGranule(size_t size) noexcept {
+    return (size + GRANULE_SIZE - 1) & ~(GRANULE_SIZE - 1);
+  }
+
+  void Assign(void *region, size_t size, AddressOwner owner) noexcept {
+    const size_t first = reinterpret_cast<uintptr_t>(region) >> GRANULE_SHIFT;
+    for (size_t granule = first; granule != first + (size >> GRANULE_SHIFT) && granule < owners_.size(); ++granule) {
+      owners_[granule] = owner;
+    }
+  }
+
+  struct Region {
+    void *begin;
+    size_t size;
+  };
+
+  // 4 MiB of zeros, only the pages of used granules are ever touched
+  std::array<AddressOwner, size_t{1} << (ADDRESS_BITS - GRANULE_SHIFT)> owners_{};
+  // Ring of the reserved released regions, the oldest one is replaced next
+  std::array<Region, RETIRED_REGIONS> retired_regions_{};
+  size_t retired_count_{0};
+};
+
+// The map of the replacement library, constant-initialized together with the system heap
+AddressOwnershipMap &GetAddressOwnershipMap() noexcept;
+
+#endif // ADDRESSOWNERSHIPMAP_H
@@ -0,0 +1,382 @@
+// Simple Allocator 2024
+#include "BenchmarkBackends.h"
+
+#include "MappedAllocator.h"
+#include "MemoryBlock.h"
+#include "SimpleAllocatorTraits.h"
+#include "TrackedPointers.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <memory_resource>
+#include <optional>
+
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+
+constexpr size_t BENCHMARK_HEAP_SIZE = 1024 * 1024 * 1024;
+
+constexpr size_t AlignSize(size_t size) noexcept {
+  return (size + SimpleAllocatorTraits::ALIGNMENT - 1) & ~(SimpleAllocatorTraits::ALIGNMENT - 1);
+}
+
+size_t SystemMallocSize(void *ptr) noexcept {
+#ifdef __APPLE__
+  return malloc_size(ptr);
+#else
+  return malloc_usable_size(ptr);
+#endif
+}
+
+class SimpleAllocatorBackend final : public BenchmarkBackend {
+public:
+  const char *Name() const noexcept final {
+    return "SIMPLE_ALLOCATOR";
+  }
+
+  void Stop() noexcept final {
+    allocator_.Release();
+  }
+
+  void *Allocate(size_t size) noexcept final {
+    return allocator_.Allocate(size);
+  }
+
+  void Deallocate(void *ptr) noexcept final {
+    allocator_.Deallocate(ptr);
+  }
+
+  void *Reallocate(void *ptr, size_t new_size) noexcept final {
+    return allocator_.Reallocate(ptr, new_size);
+  }
+
+  size_t Size(void *ptr) noexcept final {
+    return allocator_.Size(ptr);
+  }
+
+private:
+  MappedAllocator allocator_{BENCHMARK_HEAP_SIZE, AddressOwner::BENCHMARK_HEAP};
+};
+
+// Calls from inside of this library are not interposed, so std::malloc is the system one here.
+class VanillaMallocBackend final : public BenchmarkBackend {
+public:
+  const char *Name() const noexcept final {
+    return "VANILLA_MALLOC";
+  }
+
+  void *Allocate(size_t size) noexcept final {
+    return std::malloc(size);
+  }
+
+  void Deallocate(void *ptr) noexcept final {
+    std::free(ptr);
+  }
+
+  void *Reallocate(void *ptr, size_t new_size) noexcept final {
+    return std::realloc(ptr, new_size);
+  }
+
+  size_t Size(void *ptr) noexcept final {
+    return SystemMallocSize(ptr);
+  }
+};
+
+// Never reuses memory, the lower bound of what an allocator can cost. The heap starts over only when every block is freed,
+// as when a benchmark destroys its container at the top of an iteration.
+class BumpAllocatorBackend final : public BenchmarkBackend {
+public:
+  const char *Name() const noexcept final {
+    return "BUMP_ALLOCATOR";
+  }
+
+  bool ReusesMemory() const noexcept final {
+    return false;
+  }
+
+  void Start() noexcept final {
+    buffer_ = static_cast<uint8_t *>(GetAddressOwnershipMap().MapRegion(BENCHMARK_HEAP_SIZE, AddressOwner::BENCHMARK_HEAP));
+    current_ = buffer_;
+    end_ = buffer_ ? buffer_ + BENCHMARK_HEAP_SIZE : nullptr;
+    live_blocks_ = 0;
+  }
+
+  void Stop() noexcept final {
+    if (buffer_) {
+      GetAddressOwnershipMap().ReleaseRegion(buffer_, BENCHMARK_HEAP_SIZE);
+    }
+    buffer_ = current_ = end_ = nullptr;
+  }
+
+  void *Allocate(size_t size) noexcept final {
+    size = AlignSize(size);
+    if (!size || current_ + sizeof(MemoryBlock) + size > end_) {
+      return nullptr;
+    }
+    auto *memory_block = new (current_) MemoryBlock{size};
+    current_ = memory_block->UserMemoryEnd();
+    ++live_blocks_;
+    return memory_block->UserMemoryBegin();
+  }
+
+  void Deallocate(void *ptr) noexcept final {
+    if (ptr && !--live_blocks_) {
+      current_ = buffer_;
+    }
+  }
+
+  void *Reallocate(void *ptr, size_t new_size) noexcept final {
+    if (ptr && new_size) {
+      auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+      if (memory_block->UserMemoryEnd() == current_ && memory_block->UserMemoryBegin() + AlignSize(new_size) <= end_) {
+        memory_block->SetBlockSize(AlignSize(new_size));
+        current_ = memory_block->UserMemoryEnd();
+        return ptr;
+      }
+    }
+    return ReallocateByCopy(ptr, new_size);
+  }
+
+  size_t Size(void *ptr) noexcept final {
+    return ptr ? MemoryBlock::FromUserMemory(ptr)->GetBlockSize() : 0;
+  }
+
+private:
+  uint8_t *buffer_{nullptr};
+  uint8_t *current_{nullptr};
+  uint8_t *end_{nullptr};
+  size_t live_blocks_{0};
+};
+
+// Upstream for the pmr pool in a reserved region, so the blocks of the pool are known by their address. The default
+// new_delete_resource would be interposed back into the pool. An over-aligned block keeps the start of its memory in front of it.
+class ReservedResource final : public std::pmr::memory_resource {
+public:
+  void Release() noexcept {
+    heap_.Release();
+  }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) final {
+    if (alignment <= SimpleAllocatorTraits::ALIGNMENT) {
+      return AllocateOrAbort(bytes);
+    }
+    auto *memory = static_cast<uint8_t *>(AllocateOrAbort(bytes + alignment));
+    auto *ptr = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(memory) + alignment) & ~(alignment - 1));
+    reinterpret_cast<void **>(ptr)[-1] = memory;
+    return ptr;
+  }
+
+  void do_deallocate(void *ptr, size_t, size_t alignment) final {
+    heap_.Deallocate(alignment <= SimpleAllocatorTraits::ALIGNMENT ? ptr : static_cast<void **>(ptr)[-1]);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept final {
+    return this == &other;
+  }
+
+  void *AllocateOrAbort(size_t bytes) noexcept {
+    void *ptr = heap_.Allocate(bytes);
+    if (!ptr) {
+      std::abort();
+    }
+    return ptr;
+  }
+
+  MappedAllocator heap_{BENCHMARK_HEAP_SIZE, AddressOwner::BENCHMARK_HEAP};
+};
+
+// The pool needs the size on deallocation, so every block keeps the MemoryBlock header.
+class PmrPoolBackend final : public BenchmarkBackend {
+public:
+  const char *Name() const noexcept final {
+    return "PMR_POOL";
+  }
+
+  void Start() noexcept final {
+    pool_.emplace(&upstream_);
+  }
+
+  void Stop() noexcept final {
+    pool_.reset();
+    upstream_.Release();
+  }
+
+  void *Allocate(size_t size) noexcept final {
+    size = AlignSize(size);
+    if (!size) {
+      return nullptr;
+    }
+    void *memory_piece = pool_->allocate(sizeof(MemoryBlock) + size, SimpleAllocatorTraits::ALIGNMENT);
+    return (new (memory_piece) MemoryBlock{size})->UserMemoryBegin();
+  }
+
+  void Deallocate(void *ptr) noexcept final {
+    if (ptr) {
+      auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+      pool_->deallocate(memory_block, sizeof(MemoryBlock) + memory_block->GetBlockSize(), SimpleAllocatorTraits::ALIGNMENT);
+    }
+  }
+
+  void *Reallocate(void *ptr, size_t new_size) noexcept final {
+    return ReallocateByCopy(ptr, new_size);
+  }
+
+  size_t Size(void *ptr) noexcept final {
+    return ptr ? MemoryBlock::FromUserMemory(ptr)->GetBlockSize() : 0;
+  }
+
+private:
+  ReservedResource upstream_;
+  std::optional<std::pmr::unsynchronized_pool_resource> pool_;
+};
+
+// An allocator found by CMake, loaded with RTLD_LOCAL so it doesn't replace malloc for the whole process.
+// Its heap is mapped by the library itself, so every pointer it hands out is tracked until it is freed.
+class DynamicLibraryBackend final : public BenchmarkBackend {
+public:
+  struct Symbols {
+    const char *allocate;
+    const char *deallocate;
+    const char *reallocate;
+    const char *size;
+  };
+
+  constexpr DynamicLibraryBackend(const char *name, const char *library_path, Symbols symbols, Symbols alternative_symbols) noexcept
+    : name_(name)
+    , library_path_(library_path)
+    , symbols_{symbols, alternative_symbols} {}
+
+  const char *Name() const noexcept final {
+    return name_;
+  }
+
+  bool IsAvailable() noexcept final {
+    if (!loaded_ && library_path_) {
+      loaded_ = true;
+      if (void *library = dlopen(library_path_, RTLD_NOW | RTLD_LOCAL)) {
+        for (const Symbols &symbols : symbols_) {
+          if (symbols.allocate && Resolve(library, symbols)) {
+            break;
+          }
+        }
+      }
+    }
+    return allocate_ && deallocate_ && reallocate_ && size_;
+  }
+
+  void *Allocate(size_t size) noexcept final {
+    void *ptr = allocate_(size);
+    if (ptr && !GetTrackedPointers().Insert(ptr, this)) {
+      deallocate_(ptr);
+      return nullptr;
+    }
+    return ptr;
+  }
+
+  void Deallocate(void *ptr) noexcept final {
+    GetTrackedPointers().Erase(ptr);
+    deallocate_(ptr);
+  }
+
+  // The erased entry makes room for the new one, so the table never has to grow for it
+  void *Reallocate(void *ptr, size_t new_size) noexcept final {
+    void *new_ptr = reallocate_(ptr, new_size);
+    if (new_ptr || !new_size) {
+      GetTrackedPointers().Erase(ptr);
+    }
+    if (new_ptr && !GetTrackedPointers().Insert(new_ptr, this)) {
+      deallocate_(new_ptr);
+      return nullptr;
+    }
+    return new_ptr;
+  }
+
+  size_t Size(void *ptr) noexcept final {
+    return ptr ? size_(ptr) : 0;
+  }
+
+private:
+  bool Resolve(void *library, const Symbols &symbols) noexcept {
+    allocate_ = reinterpret_cast<void *(*)(size_t)>(dlsym(library, symbols.allocate));
+    deallocate_ = reinterpret_cast<void (*)(void *)>(dlsym(library, symbols.deallocate));
+    reallocate_ = reinterpret_cast<void *(*)(void *, size_t)>(dlsym(library, symbols.reallocate));
+    size_ = reinterpret_cast<size_t (*)(void *)>(dlsym(library, symbols.size));
+    return allocate_ && deallocate_ && reallocate_ && size_;
+  }
+
+  const char *name_;
+  const char *library_path_;
+  const Symbols symbols_[2];
+  bool loaded_{false};
+
+  void *(*allocate_)(size_t){nullptr};
+  void (*deallocate_)(void *){nullptr};
+  void *(*reallocate_)(void *, size_t){nullptr};
+  size_t (*size_)(void *){nullptr};
+};
+
+#ifndef JEMALLOC_LIBRARY_PATH
+#define JEMALLOC_LIBRARY_PATH nullptr
+#endif
+#ifndef TCMALLOC_LIBRARY_PATH
+#define TCMALLOC_LIBRARY_PATH nullptr
+#endif
+#ifndef MIMALLOC_LIBRARY_PATH
+#define MIMALLOC_LIBRARY_PATH nullptr
+#endif
+
+SimpleAllocatorBackend simple_allocator_backend;
+VanillaMallocBackend vanilla_malloc_backend;
+BumpAllocatorBackend bump_allocator_backend;
+PmrPoolBackend pmr_pool_backend;
+// jemalloc is built with the je_ prefix on macOS and without it on Linux
+DynamicLibraryBackend jemalloc_backend{"JEMALLOC", JEMALLOC_LIBRARY_PATH, {"je_malloc", "je_free", "je_realloc", "je_malloc_usable_size"},
+                                       {"malloc", "free", "realloc", "malloc_usable_size"}};
+DynamicLibraryBackend tcmalloc_backend{"TCMALLOC", TCMALLOC_LIBRARY_PATH, {"tc_malloc", "tc_free", "tc_realloc", "tc_malloc_size"}, {}};
+DynamicLibraryBackend mimalloc_backend{"MIMALLOC", MIMALLOC_LIBRARY_PATH, {"mi_malloc", "mi_free", "mi_realloc", "mi_usable_size"}, {}};
+
+BenchmarkBackend *const BENCHMARK_BACKENDS[]{
+  &simple_allocator_backend,
+  &vanilla_malloc_backend,
+  &bump_allocator_backend,
+  &pmr_pool_backend,
+  &jemalloc_backend,
+  &tcmalloc_backend,
+  &mimalloc_backend,
+};
+
+} // namespace
+
+void *BenchmarkBackend::ReallocateByCopy(void *ptr, size_t new_size) noexcept {
+  if (!ptr) {
+    return Allocate(new_size);
+  }
+
+  if (!new_size) {
+    Deallocate(ptr);
+    return nullptr;
+  }
+
+  void *new_ptr = Allocate(new_size);
+  if (new_ptr) {
+    std::memcpy(new_ptr, ptr, std::min(Size(ptr), new_size));
+    Deallocate(ptr);
+  }
+  return new_ptr;
+}
+
+size_t BenchmarkBackendsCount() noexcept {
+  return std::size(BENCHMARK_BACKENDS);
+}
+
+BenchmarkBackend *GetBenchmarkBackend(size_t index) noexcept {
+  return index < std::size(BENCHMARK_BACKENDS) ? BENCHMARK_BACKENDS[index] : nullptr;
+}
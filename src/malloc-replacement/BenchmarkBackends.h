@@ -0,0 +1,41 @@
+// Simple Allocator 2024
+#ifndef BENCHMARKBACKENDS_H
+#define BENCHMARKBACKENDS_H
+#include <cstddef>
+
+// An allocator which can serve malloc while a benchmark is running.
+// Backends are static objects: Start() acquires their heap and Stop() releases it with everything allocated from it.
+// free, realloc and malloc_size must find the backend of a pointer by its address, so a backend either allocates from
+// a region reserved through the address ownership map, or from the system malloc, or registers its live pointers
+// in the tracked pointers.
+class BenchmarkBackend {
+public:
+  virtual const char *Name() const noexcept = 0;
+
+  virtual bool IsAvailable() noexcept {
+    return true;
+  }
+
+  // A backend which doesn't reuse freed memory runs out on a benchmark which keeps a live set over its iterations
+  virtual bool ReusesMemory() const noexcept {
+    return true;
+  }
+
+  virtual void Start() noexcept {}
+  virtual void Stop() noexcept {}
+
+  virtual void *Allocate(size_t size) noexcept = 0;
+  virtual void Deallocate(void *ptr) noexcept = 0;
+  virtual void *Reallocate(void *ptr, size_t new_size) noexcept = 0;
+  virtual size_t Size(void *ptr) noexcept = 0;
+
+protected:
+  ~BenchmarkBackend() = default;
+
+  void *ReallocateByCopy(void *ptr, size_t new_size) noexcept;
+};
+
+size_t BenchmarkBackendsCount() noexcept;
+BenchmarkBackend *GetBenchmarkBackend(size_t index) noexcept;
+
+#endif // BENCHMARKBACKENDS_H
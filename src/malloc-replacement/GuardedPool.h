@@ -0,0 +1,288 @@
+// Simple Allocator 2024
+#ifndef GUARDEDPOOL_H
+#define GUARDEDPOOL_H
+#include "AddressOwnershipMap.h"
+
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Sampled allocations between PROT_NONE guard pages, in the spirit of GWP-ASan, to catch heap errors in production.
+// About one in sample_rate allocations of up to a page gets a page of its own, placed against the guard page behind it,
+// so an overflow faults right away. A freed page is made inaccessible and quarantined, pages are reused in the order
+// they were freed. A fault in the pool prints the error with the allocation and free stack traces, then the previous
+// SIGSEGV/SIGBUS handling takes over. Faults elsewhere go to the previous handler, which leaves the pool's one installed.
+// Other allocations pay a relaxed load while disabled and a load and a store otherwise.
+class GuardedPool {
+public:
+  static constexpr size_t MAX_SLOTS = 256;
+  static constexpr size_t MAX_FRAMES = 16;
+
+  constexpr GuardedPool() = default;
+
+  GuardedPool(const GuardedPool &) = delete;
+  GuardedPool &operator=(const GuardedPool &) = delete;
+
+  // Reserves slots_count pages with their guards and takes over the fault handlers, a process can have one pool only
+  bool Init(AddressOwnershipMap &map, size_t slots_count, uint32_t sample_rate) noexcept {
+    if (pool_ || instance_ || !slots_count || slots_count > MAX_SLOTS || !sample_rate) {
+      return false;
+    }
+    page_size_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t pool_size = (2 * slots_count + 1) * page_size_;
+    auto *pool = static_cast<uint8_t *>(map.MapRegion(pool_size, AddressOwner::GUARDED_POOL));
+    if (!pool) {
+      return false;
+    }
+    mprotect(pool, pool_size, PROT_NONE);
+
+    // The first backtrace may load the unwinder, which must not happen in the fault handler
+    void *frame;
+    backtrace(&frame, 1);
+
+    pool_ = pool;
+    pool_end_ = pool + pool_size;
+    slots_count_ = slots_count;
+    for (size_t slot = 0; slot != slots_count; ++slot) {
+      free_slots_[slot] = static_cast<uint16_t>(slot);
+    }
+    free_slots_count_ = slots_count;
+    sample_rate_ = sample_rate;
+
+    instance_ = this;
+    struct sigaction action {};
+    action.sa_sigaction = HandleFault;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previous_segv_action_);
+    sigaction(SIGBUS, &action, &previous_bus_action_);
+
+    Resample();
+    return true;
+  }
+
+  bool ShouldSample() noexcept {
+    const uint32_t countdown = countdown_.load(std::memory_order_relaxed);
+    if (countdown > 1) [[likely]] {
+      countdown_.store(countdown - 1, std::memory_order_relaxed);
+      return false;
+    }
+    return countdown && Resample();
+  }
+
+  // nullptr if the size doesn't fit a page, every slot is live, or the pool is busy, e.g. with a nested call from backtrace
+  [[gnu::cold]] void *Allocate(size_t size) noexcept {
+    if (!size || size > page_size_ || locked_.exchange(true, std::memory_order_acquire)) {
+      return nullptr;
+    }
+    void *ptr = nullptr;
+    if (free_slots_count_) {
+      const size_t slot_index = free_slots_[free_slots_begin_];
+      free_slots_begin_ = (free_slots_begin_ + 1) % MAX_SLOTS;
+      --free_slots_count_;
+
+      uint8_t *page = GetSlotPage(slot_index);
+      mprotect(page, page_size_, PROT_READ | PROT_WRITE);
+      ptr = page + page_size_ - AlignSize(size);
+
+      Slot &slot = slots_[slot_index];
+      slot.ptr = ptr;
+      slot.size = size;
+      slot.state = SlotState::LIVE;
+      slot.allocation_frames = backtrace(slot.allocation_trace.data(), MAX_FRAMES);
+      slot.free_frames = 0;
+    }
+    locked_.store(false, std::memory_order_release);
+    return ptr;
+  }
+
+  // A double or invalid free is reported and aborts the process
+  [[gnu::cold]] void Deallocate(void *ptr) noexcept {
+    Lock();
+    const size_t slot_index = GetSlotIndex(ptr);
+    Slot *slot = slot_index < slots_count_ ? &slots_[slot_index] : nullptr;
+    if (!slot || slot->ptr != ptr || slot->state != SlotState::LIVE) {
+      Report(slot && slot->ptr == ptr && slot->state == SlotState::FREED ? "double-free" : "invalid-free", ptr, slot);
+      std::abort();
+    }
+
+    slot->state = SlotState::FREED;
+    slot->free_frames = backtrace(slot->free_trace.data(), MAX_FRAMES);
+    uint8_t *page = GetSlotPage(slot_index);
+    madvise(page, page_size_, MADV_DONTNEED);
+    mprotect(page, page_size_, PROT_NONE);
+    free_slots_[(free_slots_begin_ + free_slots_count_) % MAX_SLOTS] = static_cast<uint16_t>(slot_index);
+    ++free_slots_count_;
+    Unlock();
+  }
+
+  // Usable size: up to the guard page
+  size_t Size(void *ptr) const noexcept {
+    const size_t slot_index = GetSlotIndex(ptr);
+    return slot_index < slots_count_ && slots_[slot_index].ptr == ptr ? AlignSize(slots_[slot_index].size) : 0;
+  }
+
+private:
+  enum class SlotState : uint8_t { UNUSED, LIVE, FREED };
+
+  struct Slot {
+    void *ptr;
+    size_t size;
+    SlotState state;
+    int allocation_frames;
+    int free_frames;
+    std::array<void *, MAX_FRAMES> allocation_trace;
+    std::array<void *, MAX_FRAMES> free_trace;
+  };
+
+  static constexpr size_t AlignSize(size_t size) noexcept {
+    return (size + 15) & ~size_t{15};
+  }
+
+  // Slot pages are the odd pages of the pool, the even ones are guards
+  uint8_t *GetSlotPage(size_t slot_index) const noexcept {
+    return pool_ + (2 * slot_index + 1) * page_size_;
+  }
+
+  // Slot of an address in a slot page, or of the nearest allocation to an address in a guard page
+  size_t GetSlotIndex(const void *ptr) const noexcept {
+    const auto *address = static_cast<const uint8_t *>(ptr);
+    if (address < pool_ || address >= pool_end_) {
+      return MAX_SLOTS;
+    }
+    const size_t page = static_cast<size_t>(address - pool_) / page_size_;
+    if (page % 2) {
+      return page / 2;
+    }
+    // A guard page: an overflow of the slot in front of it or an underflow of the slot behind it
+    const bool front_half = static_cast<size_t>(address - pool_) % page_size_ < page_size_ / 2;
+    return (front_half && page) || page / 2 == slots_count_ ? page / 2 - 1 : page / 2;
+  }
+
+  [[gnu::cold]] bool Resample() noexcept {
+    // xorshift32, the next distance is uniform in [1, 2 * sample_rate - 1]
+    uint32_t random = random_.load(std::memory_order_relaxed);
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    random_.store(random, std::memory_order_relaxed);
+    countdown_.store(1 + random % (2 * sample_rate_ - 1), std::memory_order_relaxed);
+    return true;
+  }
+
+  void Lock() noexcept {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      while (locked_.load(std::memory_order_relaxed)) {
+      }
+    }
+  }
+
+  void Unlock() noexcept {
+    locked_.store(false, std::memory_order_release);
+  }
+
+  static void HandleFault(int signal, siginfo_t *info, void *context) noexcept {
+    GuardedPool *pool = instance_;
+    const struct sigaction &previous_action = signal == SIGBUS ? previous_bus_action_ : previous_segv_action_;
+    const auto *address = static_cast<const uint8_t *>(info->si_addr);
+    if (!pool || address < pool->pool_ || address >= pool->pool_end_) {
+      // Not ours: the previous handler gets it as if the pool weren't there, one which recovers leaves the pool handler in place.
+      // The default action or ignoring a fault only ends the process, so the faulting access repeats with it.
+      if (previous_action.sa_flags & SA_SIGINFO) {
+        previous_action.sa_sigaction(signal, info, context);
+      } else if (previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN) {
+        previous_action.sa_handler(signal);
+      } else {
+        sigaction(signal, &previous_action, nullptr);
+      }
+      return;
+    }
+
+    const size_t slot_index = pool->GetSlotIndex(address);
+    const Slot *slot = slot_index < pool->slots_count_ ? &pool->slots_[slot_index] : nullptr;
+    const char *error = "wild-access";
+    if (slot && slot->state == SlotState::FREED && address >= pool->GetSlotPage(slot_index) && address < pool->GetSlotPage(slot_index) + pool->page_size_) {
+      error = "use-after-free";
+    } else if (slot && slot->state != SlotState::UNUSED) {
+      error = address >= slot->ptr ? "heap-buffer-overflow" : "heap-buffer-underflow";
+    }
+    pool->Report(error, address, slot);
+
+    // The faulting access repeats with the handling the process had before the pool
+    sigaction(signal, &previous_action, nullptr);
+  }
+
+  // Async-signal-safe: write and backtrace_symbols_fd only
+  static void Write(const char *text) noexcept {
+    if (write(STDERR_FILENO, text, std::strlen(text)) < 0) {
+      return;
+    }
+  }
+
+  static void WriteNumber(uint64_t value, bool hex) noexcept {
+    char digits[24];
+    char *end = digits + sizeof(digits) - 1;
+    *end = '\0';
+    char *begin = end;
+    do {
+      *--begin = "0123456789abcdef"[value % (hex ? 16 : 10)];
+      value /= hex ? 16 : 10;
+    } while (value);
+    if (hex) {
+      *--begin = 'x';
+      *--begin = '0';
+    }
+    Write(begin);
+  }
+
+  static void WriteTrace(const char *title, const std::array<void *, MAX_FRAMES> &trace, int frames) noexcept {
+    if (frames > 0) {
+      Write(title);
+      backtrace_symbols_fd(trace.data(), frames, STDERR_FILENO);
+    }
+  }
+
+  void Report(const char *error, const void *address, const Slot *slot) const noexcept {
+    Write("*** GuardedPool: ");
+    Write(error);
+    Write(" at ");
+    WriteNumber(reinterpret_cast<uintptr_t>(address), true);
+    if (slot && slot->state != SlotState::UNUSED) {
+      Write(", allocation of ");
+      WriteNumber(slot->size, false);
+      Write(" bytes at ");
+      WriteNumber(reinterpret_cast<uintptr_t>(slot->ptr), true);
+      Write("\n");
+      WriteTrace("Allocated by:\n", slot->allocation_trace, slot->allocation_frames);
+      WriteTrace("Freed by:\n", slot->free_trace, slot->free_frames);
+    } else {
+      Write("\n");
+    }
+  }
+
+  static inline GuardedPool *instance_{nullptr};
+  static inline struct sigaction previous_segv_action_ {};
+  static inline struct sigaction previous_bus_action_ {};
+
+  std::atomic<uint32_t> countdown_{0};
+  std::atomic<uint32_t> random_{0x9e3779b9};
+  std::atomic<bool> locked_{false};
+  uint32_t sample_rate_{0};
+  size_t page_size_{0};
+  uint8_t *pool_{nullptr};
+  uint8_t *pool_end_{nullptr};
+  size_t slots_count_{0};
+  std::array<Slot, MAX_SLOTS> slots_{};
+  // Ring of the free slots, the longest freed first
+  std::array<uint16_t, MAX_SLOTS> free_slots_{};
+  size_t free_slots_begin_{0};
+  size_t free_slots_count_{0};
+};
+
+#endif // GUARDEDPOOL_H
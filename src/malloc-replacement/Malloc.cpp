@@ -1,125 +1,297 @@
 // Simple Allocator 2024
 #define _GNU_SOURCE
-#include "SimpleAllocator.h"
+#include "AddressOwnershipMap.h"
+#include "BenchmarkBackends.h"
+#include "GuardedPool.h"
+#include "MallocExtensions.h"
+#include "MappedAllocator.h"
+#include "SizeProfile.h"
+#include "TrackedPointers.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <malloc/malloc.h>
-#include <optional>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+static_assert(std::is_trivially_destructible_v<MappedAllocator>, "the system allocator must outlive every other static object");
+static_assert(static_cast<size_t>(AllocationHint::COUNT) == 3);
+static_assert(static_cast<size_t>(AddressOwner::SYSTEM_SHORT_LIVED_HEAP) - static_cast<size_t>(AddressOwner::SYSTEM_HEAP) ==
+              static_cast<size_t>(AllocationHint::SHORT_LIVED));
+static_assert(static_cast<size_t>(AddressOwner::SYSTEM_BULK_HEAP) - static_cast<size_t>(AddressOwner::SYSTEM_HEAP) ==
+              static_cast<size_t>(AllocationHint::BULK));
 
 namespace {
 
-class BufferedAllocator : SimpleAllocator {
+class MallocReplacer {
 public:
-  explicit BufferedAllocator(size_t buffer_size) noexcept
-    : buffer_size_(buffer_size)
-    , buffer_(static_cast<uint8_t *>(std::malloc(buffer_size_))) {
-    Init(buffer_, buffer_size_);
+  constexpr MallocReplacer() = default;
+
+  AddressOwnershipMap &GetAddressOwnershipMap() noexcept {
+    return address_ownership_map_;
   }
 
-  using SimpleAllocator::Allocate;
-  using SimpleAllocator::Deallocate;
-  using SimpleAllocator::Reallocate;
-  using SimpleAllocator::Size;
+  TrackedPointers &GetTrackedPointers() noexcept {
+    return tracked_pointers_;
+  }
 
-  ~BufferedAllocator() noexcept {
-    std::free(buffer_);
+  MappedAllocator &GetSystemAllocator(AllocationHint hint = AllocationHint::LONG_LIVED) noexcept {
+    return system_allocators_[static_cast<size_t>(hint)];
   }
 
-private:
-  const size_t buffer_size_{0};
-  uint8_t *buffer_{nullptr};
-};
+  MappedAllocator &GetSystemAllocator(AddressOwner owner) noexcept {
+    return system_allocators_[static_cast<size_t>(owner) - static_cast<size_t>(AddressOwner::SYSTEM_HEAP)];
+  }
 
-class MallocReplacer {
-public:
-  static MallocReplacer &Instance() {
-    static MallocReplacer malloc_replacer;
-    return malloc_replacer;
+  GuardedPool &GetGuardedPool() noexcept {
+    return guarded_pool_;
   }
 
-  BufferedAllocator *GetAllocator() noexcept {
-    return active_allocator_;
+  SizeProfile &GetSizeProfile() noexcept {
+    return size_profile_;
   }
 
-  void EnableBenchmarkAllocator(bool use_simple_allocator) noexcept {
-    assert(!benchmark_allocator_.has_value());
-    assert(active_allocator_ == &system_allocator_);
-    if (use_simple_allocator) {
-      active_allocator_ = &benchmark_allocator_.emplace(1024 * 1024 * 1024);
-    } else {
-      active_allocator_ = nullptr;
-    }
+  BenchmarkBackend *GetBenchmarkBackend() noexcept {
+    return benchmark_backend_;
+  }
+
+  void EnableBenchmarkAllocator(size_t backend_index) noexcept {
+    assert(!benchmark_backend_);
+    BenchmarkBackend *backend = ::GetBenchmarkBackend(backend_index);
+    assert(backend && backend->IsAvailable());
+    backend->Start();
+    benchmark_backend_ = backend;
   }
 
   void DisableBenchmarkAllocator() noexcept {
-    assert(!active_allocator_ || active_allocator_ == &(*benchmark_allocator_));
-    benchmark_allocator_.reset();
-    active_allocator_ = &system_allocator_;
+    assert(benchmark_backend_);
+    std::exchange(benchmark_backend_, nullptr)->Stop();
   }
 
 private:
-  MallocReplacer() = default;
-
-  BufferedAllocator system_allocator_{256 * 1024 * 1024};
-  std::optional<BufferedAllocator> benchmark_allocator_;
-
-  BufferedAllocator *active_allocator_{&system_allocator_};
+  AddressOwnershipMap address_ownership_map_;
+  TrackedPointers tracked_pointers_;
+  // Hinted heaps are mapped only when MallocWithHint is used
+  std::array<MappedAllocator, 3> system_allocators_{{
+    {256 * 1024 * 1024, AddressOwner::SYSTEM_HEAP},
+    {64 * 1024 * 1024, AddressOwner::SYSTEM_SHORT_LIVED_HEAP},
+    {256 * 1024 * 1024, AddressOwner::SYSTEM_BULK_HEAP},
+  }};
+  GuardedPool guarded_pool_;
+  SizeProfile size_profile_;
+  BenchmarkBackend *benchmark_backend_{nullptr};
 };
 
+// Zero-initialized at load time: no guard on the hot path and no dependency on another allocator
+constinit MallocReplacer malloc_replacer;
+
 void *Malloc(size_t size) {
-  if (auto *allocator = MallocReplacer::Instance().GetAllocator()) {
-    auto ptr = allocator->Allocate(size);
-    assert(!(reinterpret_cast<uintptr_t>(ptr) & 0xf));
-    return ptr;
+  malloc_replacer.GetSizeProfile().Record(size);
+  if (malloc_replacer.GetGuardedPool().ShouldSample()) [[unlikely]] {
+    if (void *ptr = malloc_replacer.GetGuardedPool().Allocate(size)) {
+      return ptr;
+    }
   }
-  return std::malloc(size);
+  auto *backend = malloc_replacer.GetBenchmarkBackend();
+  auto ptr = backend ? backend->Allocate(size) : malloc_replacer.GetSystemAllocator().Allocate(size);
+  assert(!(reinterpret_cast<uintptr_t>(ptr) & 0xf));
+  return ptr;
 }
 
+// The memory of a released heap is gone, a pointer into it can only be used after its free: the caller would go on
+// with an inaccessible block, so it is reported and aborted like an invalid free in the guarded pool. Formatted on the stack,
+// the heaps may be in any state.
+[[noreturn]] [[gnu::cold]] void ReportReleasedHeapPointer(const char *function, void *ptr) noexcept {
+  char message[128];
+  const int length = std::snprintf(message, sizeof(message), "*** %s of %p in a released benchmark heap\n", function, ptr);
+  if (length > 0) {
+    [[maybe_unused]] const ssize_t written = write(STDERR_FILENO, message, std::min(static_cast<size_t>(length), sizeof(message) - 1));
+  }
+  std::abort();
+}
+
+// Calls from inside of this library are not interposed, so free/realloc/malloc_size here are the system ones.
+// They get the pointers which are neither in a reserved heap nor tracked for a backend.
 size_t MallocSize(void *ptr) {
-  if (auto *allocator = MallocReplacer::Instance().GetAllocator()) {
-    return allocator->Size(ptr);
+  switch (malloc_replacer.GetAddressOwnershipMap().Lookup(ptr)) {
+    case AddressOwner::SYSTEM_HEAP:
+    case AddressOwner::SYSTEM_SHORT_LIVED_HEAP:
+    case AddressOwner::SYSTEM_BULK_HEAP:
+      return MappedAllocator::Size(ptr);
+    case AddressOwner::BENCHMARK_HEAP:
+      return malloc_replacer.GetBenchmarkBackend()->Size(ptr);
+    case AddressOwner::GUARDED_POOL:
+      return malloc_replacer.GetGuardedPool().Size(ptr);
+    case AddressOwner::RELEASED_HEAP:
+      // Not a live block, as for any other pointer malloc doesn't know
+      return 0;
+    case AddressOwner::FOREIGN:
+      break;
+  }
+  if (auto *backend = malloc_replacer.GetTrackedPointers().Find(ptr)) {
+    return backend->Size(ptr);
   }
-  return malloc_size(ptr);
+  return ptr ? malloc_size(ptr) : 0;
 }
 
 void *Calloc(size_t count, size_t size) {
-  if (auto *allocator = MallocReplacer::Instance().GetAllocator()) {
-    const size_t total = count * size;
-    auto *ptr = allocator->Allocate(total);
-    assert(!(reinterpret_cast<uintptr_t>(ptr) & 0xf));
-    if (ptr) {
-      std::memset(ptr, 0x00, total);
-    }
-    return ptr;
+  const size_t total = count * size;
+  auto *ptr = Malloc(total);
+  if (ptr) {
+    std::memset(ptr, 0x00, total);
   }
-  return std::calloc(count, size);
+  return ptr;
 }
 
 void Free(void *ptr) {
-  if (auto *allocator = MallocReplacer::Instance().GetAllocator()) {
-    return allocator->Deallocate(ptr);
+  switch (const AddressOwner owner = malloc_replacer.GetAddressOwnershipMap().Lookup(ptr)) {
+    case AddressOwner::SYSTEM_HEAP:
+    case AddressOwner::SYSTEM_SHORT_LIVED_HEAP:
+    case AddressOwner::SYSTEM_BULK_HEAP:
+      return malloc_replacer.GetSystemAllocator(owner).Deallocate(ptr);
+    case AddressOwner::BENCHMARK_HEAP:
+      return malloc_replacer.GetBenchmarkBackend()->Deallocate(ptr);
+    case AddressOwner::GUARDED_POOL:
+      return malloc_replacer.GetGuardedPool().Deallocate(ptr);
+    case AddressOwner::RELEASED_HEAP:
+      ReportReleasedHeapPointer("free", ptr);
+    case AddressOwner::FOREIGN:
+      break;
+  }
+  if (auto *backend = malloc_replacer.GetTrackedPointers().Find(ptr)) {
+    return backend->Deallocate(ptr);
   }
   std::free(ptr);
 }
 
+// The block stays in the heap which owns it, even if another one is active now
 void *Realloc(void *ptr, size_t size) {
-  if (auto *allocator = MallocReplacer::Instance().GetAllocator()) {
-    auto new_ptr = allocator->Reallocate(ptr, size);
-    assert(!(reinterpret_cast<uintptr_t>(new_ptr) & 0xf));
-    return new_ptr;
+  if (!ptr) {
+    return Malloc(size);
+  }
+
+  malloc_replacer.GetSizeProfile().Record(size);
+  void *new_ptr = nullptr;
+  switch (const AddressOwner owner = malloc_replacer.GetAddressOwnershipMap().Lookup(ptr)) {
+    case AddressOwner::SYSTEM_HEAP:
+    case AddressOwner::SYSTEM_SHORT_LIVED_HEAP:
+    case AddressOwner::SYSTEM_BULK_HEAP:
+      new_ptr = malloc_replacer.GetSystemAllocator(owner).Reallocate(ptr, size);
+      break;
+    case AddressOwner::BENCHMARK_HEAP:
+      new_ptr = malloc_replacer.GetBenchmarkBackend()->Reallocate(ptr, size);
+      break;
+    case AddressOwner::GUARDED_POOL:
+      // Always moves: the new size gets a guard of its own or goes to the heap
+      new_ptr = size ? Malloc(size) : nullptr;
+      if (size && !new_ptr) {
+        return nullptr;
+      }
+      if (new_ptr) {
+        std::memcpy(new_ptr, ptr, std::min(malloc_replacer.GetGuardedPool().Size(ptr), size));
+      }
+      malloc_replacer.GetGuardedPool().Deallocate(ptr);
+      break;
+    case AddressOwner::RELEASED_HEAP:
+      ReportReleasedHeapPointer("realloc", ptr);
+    case AddressOwner::FOREIGN:
+      if (auto *backend = malloc_replacer.GetTrackedPointers().Find(ptr)) {
+        new_ptr = backend->Reallocate(ptr, size);
+      } else {
+        new_ptr = std::realloc(ptr, size);
+      }
+      break;
+  }
+  assert(!(reinterpret_cast<uintptr_t>(new_ptr) & 0xf));
+  return new_ptr;
+}
+
+// SIMPLE_ALLOCATOR_SIZE_PROFILE=<file> collects the requested sizes of the whole process for generate-size-classes
+const char *size_profile_path = nullptr;
+
+[[gnu::constructor]] void StartSizeProfile() {
+  size_profile_path = std::getenv("SIMPLE_ALLOCATOR_SIZE_PROFILE");
+  if (size_profile_path && *size_profile_path) {
+    malloc_replacer.GetSizeProfile().Enable();
+  }
+}
+
+[[gnu::destructor]] void WriteSizeProfile() {
+  if (!size_profile_path || !*size_profile_path) {
+    return;
+  }
+  // Writing allocates too
+  malloc_replacer.GetSizeProfile().Disable();
+  if (std::FILE *file = std::fopen(size_profile_path, "w")) {
+    if (!malloc_replacer.GetSizeProfile().Write(file)) {
+      std::fprintf(stderr, "Failed to write the size profile to %s\n", size_profile_path);
+    }
+    std::fclose(file);
+  } else {
+    std::fprintf(stderr, "Failed to open the size profile %s\n", size_profile_path);
+  }
+}
+
+// SIMPLE_ALLOCATOR_GUARDED_SAMPLE_RATE=<n> places about one in n allocations between guard pages,
+// SIMPLE_ALLOCATOR_GUARDED_SLOTS=<count> sets how many of them can be live or quarantined, 64 by default
+[[gnu::constructor]] void StartGuardedPool() {
+  const char *sample_rate = std::getenv("SIMPLE_ALLOCATOR_GUARDED_SAMPLE_RATE");
+  if (!sample_rate || !*sample_rate) {
+    return;
+  }
+  const char *slots = std::getenv("SIMPLE_ALLOCATOR_GUARDED_SLOTS");
+  const size_t slots_count = slots && *slots ? std::strtoull(slots, nullptr, 10) : 64;
+  const auto rate = static_cast<uint32_t>(std::strtoul(sample_rate, nullptr, 10));
+  if (!malloc_replacer.GetGuardedPool().Init(malloc_replacer.GetAddressOwnershipMap(), slots_count, rate)) {
+    std::fprintf(stderr, "Failed to start the guarded pool with the sample rate %s and %zu slots\n", sample_rate, slots_count);
   }
-  return std::realloc(ptr, size);
 }
 
 } // namespace
 
-void EnableBenchmarkAllocator(bool use_simple_allocator) noexcept {
-  MallocReplacer::Instance().EnableBenchmarkAllocator(use_simple_allocator);
+void *MallocWithHint(size_t size, AllocationHint hint) noexcept {
+  malloc_replacer.GetSizeProfile().Record(size);
+  if (auto *backend = malloc_replacer.GetBenchmarkBackend()) {
+    return backend->Allocate(size);
+  }
+  return malloc_replacer.GetSystemAllocator(hint).Allocate(size);
+}
+
+AddressOwnershipMap &GetAddressOwnershipMap() noexcept {
+  return malloc_replacer.GetAddressOwnershipMap();
+}
+
+TrackedPointers &GetTrackedPointers() noexcept {
+  return malloc_replacer.GetTrackedPointers();
+}
+
+size_t GetBenchmarkBackendsCount() noexcept {
+  return BenchmarkBackendsCount();
+}
+
+const char *GetBenchmarkBackendName(size_t backend) noexcept {
+  return GetBenchmarkBackend(backend)->Name();
+}
+
+bool IsBenchmarkBackendAvailable(size_t backend) noexcept {
+  return GetBenchmarkBackend(backend)->IsAvailable();
+}
+
+bool DoesBenchmarkBackendReuseMemory(size_t backend) noexcept {
+  return GetBenchmarkBackend(backend)->ReusesMemory();
+}
+
+void EnableBenchmarkAllocator(size_t backend) noexcept {
+  malloc_replacer.EnableBenchmarkAllocator(backend);
 }
 
 void DisableBenchmarkAllocator() noexcept {
-  MallocReplacer::Instance().DisableBenchmarkAllocator();
+  malloc_replacer.DisableBenchmarkAllocator();
 }
 
 #define DYLD_INTERPOSE(_replacment, _replacee)                                                                                                                 \
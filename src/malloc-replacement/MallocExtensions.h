@@ -0,0 +1,12 @@
+// Simple Allocator 2024
+#ifndef MALLOCEXTENSIONS_H
+#define MALLOCEXTENSIONS_H
+#include "HintedSimpleAllocator.h"
+
+#include <cstddef>
+
+// malloc from a separate system heap per lifetime hint, the memory is freed with the regular free/realloc.
+// Benchmark backends ignore the hint.
+[[gnu::malloc]] [[gnu::alloc_size(1)]] void *MallocWithHint(size_t size, AllocationHint hint) noexcept;
+
+#endif // MALLOCEXTENSIONS_H
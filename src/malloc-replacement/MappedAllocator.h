@@ -0,0 +1,57 @@
+// Simple Allocator 2024
+#ifndef MAPPEDALLOCATOR_H
+#define MAPPEDALLOCATOR_H
+#include "AddressOwnershipMap.h"
+#include "SimpleAllocator.h"
+
+// SimpleAllocator which maps its arena directly from the OS on the first allocation, registered in the address ownership map.
+// It is constant-initialized, so a global instance doesn't depend on any other allocator or on the static initialization order.
+// The arena is never unmapped implicitly: frees may keep coming until the very end of the process.
+class MappedAllocator : SimpleAllocator {
+public:
+  constexpr MappedAllocator(size_t arena_size, AddressOwner owner) noexcept
+    : arena_size_(arena_size)
+    , owner_(owner) {}
+
+  [[gnu::malloc]] [[gnu::alloc_size(2)]] void *Allocate(size_t size) noexcept {
+    if (void *ptr = SimpleAllocator::Allocate(size)) [[likely]] {
+      return ptr;
+    }
+    return AllocateSlow(size);
+  }
+
+  [[gnu::alloc_size(3)]] void *Reallocate(void *ptr, size_t new_size) noexcept {
+    return ptr ? SimpleAllocator::Reallocate(ptr, new_size) : Allocate(new_size);
+  }
+
+  using SimpleAllocator::Deallocate;
+  using SimpleAllocator::HeapExtent;
+  using SimpleAllocator::Size;
+
+  // Releases the arena and forgets everything allocated from it.
+  void Release() noexcept {
+    if (arena_) {
+      GetAddressOwnershipMap().ReleaseRegion(arena_, arena_size_);
+      *this = MappedAllocator{arena_size_, owner_};
+    }
+  }
+
+private:
+  [[gnu::cold]] [[gnu::noinline]] void *AllocateSlow(size_t size) noexcept {
+    if (arena_ || !size) {
+      return nullptr;
+    }
+    void *arena = GetAddressOwnershipMap().MapRegion(arena_size_, owner_);
+    if (!arena || !Init(arena, arena_size_)) {
+      return nullptr;
+    }
+    arena_ = arena;
+    return SimpleAllocator::Allocate(size);
+  }
+
+  size_t arena_size_{0};
+  AddressOwner owner_{AddressOwner::FOREIGN};
+  void *arena_{nullptr};
+};
+
+#endif // MAPPEDALLOCATOR_H
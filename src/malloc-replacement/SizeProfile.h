@@ -0,0 +1,71 @@
+// Simple Allocator 2024
+#ifndef SIZEPROFILE_H
+#define SIZEPROFILE_H
+#include "SimpleAllocatorTraits.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Counts of the requested sizes: per aligned size up to the slot cutoff, per power of 2 above it.
+// Recording is a relaxed load of a flag while disabled, so the profile can stay compiled into the library.
+class SizeProfile {
+public:
+  static constexpr size_t SLOT_BUCKETS = SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT;
+  static constexpr size_t LARGE_BUCKETS = 48;
+
+  void Enable() noexcept {
+    enabled_.store(true, std::memory_order_relaxed);
+  }
+
+  void Disable() noexcept {
+    enabled_.store(false, std::memory_order_relaxed);
+  }
+
+  void Record(size_t size) noexcept {
+    if (enabled_.load(std::memory_order_relaxed)) [[unlikely]] {
+      counts_[GetBucketIndex(size)].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Writes "size count" lines of the non-empty buckets, which generate-size-classes reads.
+  // Sizes from the slot cutoff on are the lower bounds of their power of 2 buckets.
+  bool Write(std::FILE *file) const noexcept {
+    if (std::fprintf(file, "# size count\n") < 0) {
+      return false;
+    }
+    for (size_t index = 1; index != counts_.size(); ++index) {
+      if (const uint64_t count = counts_[index].load(std::memory_order_relaxed)) {
+        if (std::fprintf(file, "%zu %llu\n", GetBucketSize(index), static_cast<unsigned long long>(count)) < 0) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  static constexpr size_t GetBucketIndex(size_t size) noexcept {
+    const size_t aligned_size = size / SimpleAllocatorTraits::ALIGNMENT + (size % SimpleAllocatorTraits::ALIGNMENT != 0);
+    if (aligned_size < SLOT_BUCKETS) {
+      return aligned_size;
+    }
+    const size_t large_bucket = static_cast<size_t>(std::bit_width(aligned_size / SLOT_BUCKETS)) - 1;
+    return SLOT_BUCKETS + (large_bucket < LARGE_BUCKETS ? large_bucket : LARGE_BUCKETS - 1);
+  }
+
+  static constexpr size_t GetBucketSize(size_t index) noexcept {
+    if (index < SLOT_BUCKETS) {
+      return index * SimpleAllocatorTraits::ALIGNMENT;
+    }
+    return SimpleAllocatorTraits::MAX_SLOT_SIZE << (index - SLOT_BUCKETS);
+  }
+
+private:
+  std::atomic<bool> enabled_{false};
+  std::array<std::atomic<uint64_t>, SLOT_BUCKETS + LARGE_BUCKETS> counts_{};
+};
+
+#endif // SIZEPROFILE_H
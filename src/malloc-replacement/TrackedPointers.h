@@ -0,0 +1,120 @@
+// Simple Allocator 2024
+#ifndef TRACKEDPOINTERS_H
+#define TRACKEDPOINTERS_H
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+class BenchmarkBackend;
+
+// Live pointers of the backends whose heap is neither reserved through the address ownership map nor the system malloc,
+// with the backend which handed each out. An open-addressing table with linear probing, mapped from the OS and doubled
+// at half load, so it never calls malloc. A lookup while nothing is tracked is a load and a compare.
+class TrackedPointers {
+public:
+  constexpr TrackedPointers() = default;
+
+  TrackedPointers(const TrackedPointers &) = delete;
+  TrackedPointers &operator=(const TrackedPointers &) = delete;
+
+  BenchmarkBackend *Find(const void *ptr) const noexcept {
+    if (!count_) [[likely]] {
+      return nullptr;
+    }
+    for (size_t i = Home(ptr);; i = (i + 1) & (capacity_ - 1)) {
+      if (entries_[i].ptr == ptr) {
+        return entries_[i].owner;
+      }
+      if (!entries_[i].ptr) {
+        return nullptr;
+      }
+    }
+  }
+
+  // False if the table can't grow, the pointer stays untracked
+  bool Insert(const void *ptr, BenchmarkBackend *owner) noexcept {
+    if (2 * (count_ + 1) > capacity_ && !Grow()) {
+      return false;
+    }
+    size_t i = Home(ptr);
+    while (entries_[i].ptr && entries_[i].ptr != ptr) {
+      i = (i + 1) & (capacity_ - 1);
+    }
+    count_ += entries_[i].ptr ? 0 : 1;
+    entries_[i] = {ptr, owner};
+    return true;
+  }
+
+  // Shifts the entries after the erased one back into the hole, so the table needs no tombstones
+  void Erase(const void *ptr) noexcept {
+    if (!count_) {
+      return;
+    }
+    size_t hole = Home(ptr);
+    while (entries_[hole].ptr != ptr) {
+      if (!entries_[hole].ptr) {
+        return;
+      }
+      hole = (hole + 1) & (capacity_ - 1);
+    }
+    for (size_t i = (hole + 1) & (capacity_ - 1); entries_[i].ptr; i = (i + 1) & (capacity_ - 1)) {
+      // The entry may move if the hole is on its probe sequence, between its home and where it is now
+      if (((i - Home(entries_[i].ptr)) & (capacity_ - 1)) >= ((i - hole) & (capacity_ - 1))) {
+        entries_[hole] = entries_[i];
+        hole = i;
+      }
+    }
+    entries_[hole] = {};
+    --count_;
+  }
+
+  size_t Count() const noexcept {
+    return count_;
+  }
+
+private:
+  static constexpr size_t MIN_CAPACITY = 4096;
+
+  struct Entry {
+    const void *ptr;
+    BenchmarkBackend *owner;
+  };
+
+  // Fibonacci hashing of the address without the alignment bits
+  size_t Home(const void *ptr) const noexcept {
+    return static_cast<size_t>(((reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9e3779b97f4a7c15ull) >> shift_);
+  }
+
+  bool Grow() noexcept {
+    const size_t capacity = capacity_ ? 2 * capacity_ : MIN_CAPACITY;
+    void *mapping = mmap(nullptr, capacity * sizeof(Entry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+    Entry *entries = entries_;
+    const size_t old_capacity = capacity_;
+    entries_ = static_cast<Entry *>(mapping);
+    capacity_ = capacity;
+    shift_ = 64 - static_cast<unsigned>(__builtin_ctzll(capacity));
+    count_ = 0;
+    for (size_t i = 0; i != old_capacity; ++i) {
+      if (entries[i].ptr) {
+        Insert(entries[i].ptr, entries[i].owner);
+      }
+    }
+    if (entries) {
+      munmap(entries, old_capacity * sizeof(Entry));
+    }
+    return true;
+  }
+
+  Entry *entries_{nullptr};
+  size_t capacity_{0};
+  size_t count_{0};
+  unsigned shift_{64};
+};
+
+// The table of the replacement library, constant-initialized together with the system heap
+TrackedPointers &GetTrackedPointers() noexcept;
+
+#endif // TRACKEDPOINTERS_H
@@ -0,0 +1,249 @@
+// Simple Allocator 2024
+#include "CompactBlockIndex.h"
+
+#include "MemoryBlock.h"
+#include "SimpleAllocatorTraits.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+
+size_t CompactBlockIndex::GetMaxChunks(size_t heap_size) noexcept {
+  // Large blocks don't overlap, so a heap holds at most this many of them, and chunks are at least half full
+  const size_t max_blocks = heap_size / (sizeof(MemoryBlock) + SimpleAllocatorTraits::MAX_SLOT_SIZE);
+  return max_blocks ? 2 * max_blocks / CHUNK_ENTRIES + 2 : 0;
+}
+
+size_t CompactBlockIndex::RequiredSize(size_t heap_size) noexcept {
+  return GetMaxChunks(heap_size) * (sizeof(size_t) + sizeof(Chunk *) + sizeof(Chunk));
+}
+
+bool CompactBlockIndex::Init(void *metadata, size_t metadata_size, size_t heap_size) noexcept {
+  const size_t max_chunks = GetMaxChunks(heap_size);
+  if (pool_ || metadata_size < RequiredSize(heap_size) || reinterpret_cast<uintptr_t>(metadata) % alignof(Chunk)) {
+    return false;
+  }
+  if (!max_chunks) {
+    return true;
+  }
+
+  // Chunks first, they have the strictest alignment
+  pool_ = static_cast<Chunk *>(metadata);
+  last_sizes_ = reinterpret_cast<size_t *>(pool_ + max_chunks);
+  chunks_ = reinterpret_cast<Chunk **>(last_sizes_ + max_chunks);
+  max_chunks_ = max_chunks;
+  for (size_t chunk = max_chunks; chunk != 0; --chunk) {
+    pool_[chunk - 1].next_free = free_chunks_;
+    free_chunks_ = &pool_[chunk - 1];
+  }
+  return true;
+}
+
+size_t CompactBlockIndex::GetLowerBound(const Chunk *chunk, size_t size) noexcept {
+  const auto is_smaller = [](const Entry &entry, size_t size) noexcept { return entry.size < size; };
+  return static_cast<size_t>(std::lower_bound(chunk->entries, chunk->entries + chunk->count, size, is_smaller) - chunk->entries);
+}
+
+size_t CompactBlockIndex::GetUpperBound(const Chunk *chunk, size_t size) noexcept {
+  const auto is_greater = [](size_t size, const Entry &entry) noexcept { return size < entry.size; };
+  return static_cast<size_t>(std::upper_bound(chunk->entries, chunk->entries + chunk->count, size, is_greater) - chunk->entries);
+}
+
+size_t CompactBlockIndex::FindInsertChunk(size_t size) const noexcept {
+  const size_t chunk_index = static_cast<size_t>(std::upper_bound(last_sizes_, last_sizes_ + chunks_count_, size) - last_sizes_);
+  return std::min(chunk_index, chunks_count_ - 1);
+}
+
+void CompactBlockIndex::InsertBlock(MemoryBlock *memory_block) noexcept {
+  const Entry entry{memory_block->GetBlockSize(), memory_block};
+  if (!chunks_count_) {
+    InsertChunk(0, NewChunk());
+  }
+
+  size_t chunk_index = FindInsertChunk(entry.size);
+  if (chunks_[chunk_index]->count == CHUNK_ENTRIES) {
+    SplitChunk(chunk_index);
+    if (last_sizes_[chunk_index] <= entry.size) {
+      ++chunk_index;
+    }
+  }
+
+  Chunk *chunk = chunks_[chunk_index];
+  const size_t position = GetUpperBound(chunk, entry.size);
+  std::memmove(chunk->entries + position + 1, chunk->entries + position, (chunk->count - position) * sizeof(Entry));
+  chunk->entries[position] = entry;
+  ++chunk->count;
+  last_sizes_[chunk_index] = chunk->entries[chunk->count - 1].size;
+}
+
+MemoryBlock *CompactBlockIndex::RetrieveBlock(size_t size) noexcept {
+  // The best fitting size, then the last block of that size, which is where the run of its blocks ends
+  size_t chunk_index = static_cast<size_t>(std::lower_bound(last_sizes_, last_sizes_ + chunks_count_, size) - last_sizes_);
+  if (chunk_index == chunks_count_) {
+    return nullptr;
+  }
+  const Chunk *chunk = chunks_[chunk_index];
+  const size_t fit_size = chunk->entries[GetLowerBound(chunk, size)].size;
+  size_t position = GetUpperBound(chunk, fit_size);
+  if (position == chunk->count && chunk_index + 1 != chunks_count_ && chunks_[chunk_index + 1]->entries[0].size == fit_size) {
+    // The run goes on in the next chunks
+    chunk_index = FindInsertChunk(fit_size);
+    position = GetUpperBound(chunks_[chunk_index], fit_size);
+    if (!position) {
+      position = chunks_[--chunk_index]->count;
+    }
+  }
+  MemoryBlock *memory_block = chunks_[chunk_index]->entries[position - 1].block;
+  EraseEntry(chunk_index, position - 1);
+  return memory_block;
+}
+
+// The run of the size starts in the first chunk which ends with the size or a larger one, and may go on in the next chunks
+bool CompactBlockIndex::RemoveBlock(MemoryBlock *memory_block) noexcept {
+  const size_t size = memory_block->GetBlockSize();
+  for (auto chunk_index = static_cast<size_t>(std::lower_bound(last_sizes_, last_sizes_ + chunks_count_, size) - last_sizes_); chunk_index != chunks_count_;
+       ++chunk_index) {
+    const Chunk *chunk = chunks_[chunk_index];
+    for (size_t entry_index = GetLowerBound(chunk, size); entry_index != chunk->count && chunk->entries[entry_index].size == size; ++entry_index) {
+      if (chunk->entries[entry_index].block == memory_block) {
+        EraseEntry(chunk_index, entry_index);
+        return true;
+      }
+    }
+    if (last_sizes_[chunk_index] != size) {
+      break;
+    }
+  }
+  return false;
+}
+
+CompactBlockIndex::Chunk *CompactBlockIndex::NewChunk() noexcept {
+  assert(free_chunks_);
+  Chunk *chunk = free_chunks_;
+  free_chunks_ = chunk->next_free;
+  chunk->count = 0;
+  return chunk;
+}
+
+void CompactBlockIndex::InsertChunk(size_t chunk_index, Chunk *chunk) noexcept {
+  assert(chunks_count_ < max_chunks_);
+  const size_t moved = chunks_count_ - chunk_index;
+  std::memmove(last_sizes_ + chunk_index + 1, last_sizes_ + chunk_index, moved * sizeof(size_t));
+  std::memmove(chunks_ + chunk_index + 1, chunks_ + chunk_index, moved * sizeof(Chunk *));
+  chunks_[chunk_index] = chunk;
+  if (chunk->count) {
+    last_sizes_[chunk_index] = chunk->entries[chunk->count - 1].size;
+  }
+  ++chunks_count_;
+}
+
+void CompactBlockIndex::RemoveChunk(size_t chunk_index) noexcept {
+  Chunk *chunk = chunks_[chunk_index];
+  chunk->next_free = free_chunks_;
+  free_chunks_ = chunk;
+
+  --chunks_count_;
+  const size_t moved = chunks_count_ - chunk_index;
+  std::memmove(last_sizes_ + chunk_index, last_sizes_ + chunk_index + 1, moved * sizeof(size_t));
+  std::memmove(chunks_ + chunk_index, chunks_ + chunk_index + 1, moved * sizeof(Chunk *));
+}
+
+void CompactBlockIndex::SplitChunk(size_t chunk_index) noexcept {
+  Chunk *chunk = chunks_[chunk_index];
+  Chunk *upper_half = NewChunk();
+  upper_half->count = chunk->count / 2;
+  chunk->count -= upper_half->count;
+  std::memcpy(upper_half->entries, chunk->entries + chunk->count, upper_half->count * sizeof(Entry));
+  last_sizes_[chunk_index] = chunk->entries[chunk->count - 1].size;
+  InsertChunk(chunk_index + 1, upper_half);
+}
+
+// Merges two neighbours if they fit a chunk, otherwise splits their pairs evenly
+void CompactBlockIndex::BalanceChunks(size_t left_index) noexcept {
+  Chunk *left = chunks_[left_index];
+  Chunk *right = chunks_[left_index + 1];
+  if (left->count + right->count <= CHUNK_ENTRIES) {
+    std::memcpy(left->entries + left->count, right->entries, right->count * sizeof(Entry));
+    left->count += right->count;
+    last_sizes_[left_index] = last_sizes_[left_index + 1];
+    RemoveChunk(left_index + 1);
+    return;
+  }
+
+  const size_t left_count = (left->count + right->count) / 2;
+  if (left->count > left_count) {
+    const size_t moved = left->count - left_count;
+    std::memmove(right->entries + moved, right->entries, right->count * sizeof(Entry));
+    std::memcpy(right->entries, left->entries + left_count, moved * sizeof(Entry));
+    right->count += moved;
+  } else {
+    const size_t moved = left_count - left->count;
+    std::memcpy(left->entries + left->count, right->entries, moved * sizeof(Entry));
+    std::memmove(right->entries, right->entries + moved, (right->count - moved) * sizeof(Entry));
+    right->count -= moved;
+  }
+  left->count = left_count;
+  last_sizes_[left_index] = left->entries[left_count - 1].size;
+}
+
+void CompactBlockIndex::EraseEntry(size_t chunk_index, size_t entry_index) noexcept {
+  Chunk *chunk = chunks_[chunk_index];
+  --chunk->count;
+  std::memmove(chunk->entries + entry_index, chunk->entries + entry_index + 1, (chunk->count - entry_index) * sizeof(Entry));
+  if (!chunk->count) {
+    RemoveChunk(chunk_index);
+    return;
+  }
+  last_sizes_[chunk_index] = chunk->entries[chunk->count - 1].size;
+
+  if (chunk->count < CHUNK_ENTRIES / 2 && chunks_count_ > 1) {
+    BalanceChunks(chunk_index + 1 < chunks_count_ ? chunk_index : chunk_index - 1);
+  }
+}
+
+bool CompactBlockIndex::ForEachBlock(bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) const noexcept {
+  for (size_t chunk_index = 0; chunk_index != chunks_count_; ++chunk_index) {
+    const Chunk *chunk = chunks_[chunk_index];
+    for (size_t entry_index = 0; entry_index != chunk->count; ++entry_index) {
+      if (!visitor(chunk->entries[entry_index].block, context)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool CompactBlockIndex::Validate(const void *begin, const void *end, size_t max_blocks) const noexcept {
+  const auto *heap_begin = static_cast<const uint8_t *>(begin);
+  const auto *heap_end = static_cast<const uint8_t *>(end);
+  if (chunks_count_ > max_chunks_) {
+    return false;
+  }
+
+  const Entry *previous = nullptr;
+  size_t blocks = 0;
+  for (size_t chunk_index = 0; chunk_index != chunks_count_; ++chunk_index) {
+    const Chunk *chunk = chunks_[chunk_index];
+    if (chunk < pool_ || chunk >= pool_ + max_chunks_ || !chunk->count || chunk->count > CHUNK_ENTRIES ||
+        (chunks_count_ > 1 && chunk->count < CHUNK_ENTRIES / 2)) {
+      return false;
+    }
+    if (chunk->entries[chunk->count - 1].size != last_sizes_[chunk_index]) {
+      return false;
+    }
+
+    for (const Entry &entry : std::span{chunk->entries, chunk->count}) {
+      const auto *memory = reinterpret_cast<const uint8_t *>(entry.block) + sizeof(MemoryBlock);
+      if (++blocks > max_blocks || (previous && previous->size > entry.size) || memory < heap_begin + sizeof(MemoryBlock) || memory > heap_end ||
+          reinterpret_cast<uintptr_t>(memory) % SimpleAllocatorTraits::ALIGNMENT || entry.block->GetBlockSize() != entry.size ||
+          entry.size > static_cast<size_t>(heap_end - memory)) {
+        return false;
+      }
+      previous = &entry;
+    }
+  }
+  return true;
+}
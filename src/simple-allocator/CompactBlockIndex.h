@@ -0,0 +1,67 @@
+// Simple Allocator 2024
+#ifndef COMPACTBLOCKINDEX_H
+#define COMPACTBLOCKINDEX_H
+#include <cstddef>
+
+class MemoryBlock;
+
+// Index of the large free blocks with the interface of MemoryTree, but with its metadata in a region of its own instead of
+// the freed memory: (size, block) pairs sorted by size in chunks, and the last size of every chunk in a dense array searched first.
+// A lookup touches a few lines of metadata and never the free blocks, so their pages can be purged.
+// The region is sized for the most large blocks a heap can hold, so an insert never fails.
+class CompactBlockIndex {
+public:
+  // Bytes of metadata for a heap of heap_size bytes, zero if the heap is too small for a large block
+  static size_t RequiredSize(size_t heap_size) noexcept;
+  bool Init(void *metadata, size_t metadata_size, size_t heap_size) noexcept;
+
+  void InsertBlock(MemoryBlock *memory_block) noexcept;
+  MemoryBlock *RetrieveBlock(size_t size) noexcept;
+  bool RemoveBlock(MemoryBlock *memory_block) noexcept;
+
+  // Same as MemoryTree: in the order of sizes, a visitor returning false stops the walk
+  bool ForEachBlock(bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) const noexcept;
+
+  // Checks the order of the sizes, the chunk invariants and that every pair is a block of the heap between begin and end with its size
+  bool Validate(const void *begin, const void *end, size_t max_blocks) const noexcept;
+
+private:
+  static constexpr size_t CHUNK_ENTRIES = 64;
+
+  // Blocks of a size are taken last in, first out, as from the tree
+  struct Entry {
+    size_t size;
+    MemoryBlock *block;
+  };
+
+  struct Chunk {
+    size_t count;
+    Chunk *next_free;
+    Entry entries[CHUNK_ENTRIES];
+  };
+
+  static size_t GetMaxChunks(size_t heap_size) noexcept;
+
+  // Positions in a chunk: the first pair of at least the size, and the first one over it
+  static size_t GetLowerBound(const Chunk *chunk, size_t size) noexcept;
+  static size_t GetUpperBound(const Chunk *chunk, size_t size) noexcept;
+  // The chunk where a block of the size goes in behind the others of its size
+  size_t FindInsertChunk(size_t size) const noexcept;
+
+  Chunk *NewChunk() noexcept;
+  void InsertChunk(size_t chunk_index, Chunk *chunk) noexcept;
+  void RemoveChunk(size_t chunk_index) noexcept;
+  void SplitChunk(size_t chunk_index) noexcept;
+  void BalanceChunks(size_t left_index) noexcept;
+  void EraseEntry(size_t chunk_index, size_t entry_index) noexcept;
+
+  // Every chunk is at least half full unless it's the only one, which bounds the number of chunks
+  size_t *last_sizes_{nullptr};
+  Chunk **chunks_{nullptr};
+  size_t chunks_count_{0};
+  Chunk *pool_{nullptr};
+  size_t max_chunks_{0};
+  Chunk *free_chunks_{nullptr};
+};
+
+#endif // COMPACTBLOCKINDEX_H
@@ -0,0 +1,92 @@
+// Simple Allocator 2024
+#include "CompactingSimpleAllocator.h"
+
+#include "MemoryBlock.h"
+
+#include <cstdint>
+
+bool CompactingSimpleAllocator::Init(void *buffer, size_t buffer_size, size_t max_handles) noexcept {
+  if (handles_ || !max_handles || max_handles >= UINT32_MAX) {
+    return false;
+  }
+
+  // The entries aren't touched before they are handed out, a large table costs address space only
+  const uintptr_t table_begin = (reinterpret_cast<uintptr_t>(buffer) + alignof(HandleEntry) - 1) & ~(alignof(HandleEntry) - 1);
+  const uintptr_t table_end = table_begin + (max_handles + 1) * sizeof(HandleEntry);
+  if (table_end <= table_begin || table_end >= reinterpret_cast<uintptr_t>(buffer) + buffer_size) {
+    return false;
+  }
+  if (!allocator_.Init(reinterpret_cast<void *>(table_end), reinterpret_cast<uintptr_t>(buffer) + buffer_size - table_end)) {
+    return false;
+  }
+  handles_ = reinterpret_cast<HandleEntry *>(table_begin);
+  max_handles_ = max_handles;
+  return true;
+}
+
+Handle CompactingSimpleAllocator::Allocate(size_t size) noexcept {
+  if (!free_handles_ && handles_used_ > max_handles_) {
+    return {};
+  }
+  void *ptr = allocator_.Allocate(size);
+  if (!ptr) {
+    return {};
+  }
+
+  uint32_t index = free_handles_;
+  if (index) {
+    free_handles_ = handles_[index].next_free;
+  } else {
+    index = static_cast<uint32_t>(handles_used_++);
+  }
+  handles_[index] = {ptr, 0, 0};
+  MemoryBlock::FromUserMemory(ptr)->SetHandleIndex(index);
+  return {index};
+}
+
+void CompactingSimpleAllocator::Deallocate(Handle handle) noexcept {
+  if (!handle) {
+    return;
+  }
+  // Freeing clears the index in the header, the compaction doesn't mistake the block for a live one
+  allocator_.Deallocate(handles_[handle.index].ptr);
+  handles_[handle.index] = {nullptr, 0, free_handles_};
+  free_handles_ = handle.index;
+}
+
+void *CompactingSimpleAllocator::Pin(Handle handle) noexcept {
+  if (!handle) {
+    return nullptr;
+  }
+  ++handles_[handle.index].pins;
+  return handles_[handle.index].ptr;
+}
+
+void CompactingSimpleAllocator::Unpin(Handle handle) noexcept {
+  if (handle && handles_[handle.index].pins) {
+    --handles_[handle.index].pins;
+  }
+}
+
+size_t CompactingSimpleAllocator::Size(Handle handle) const noexcept {
+  return handle ? SimpleAllocator::Size(handles_[handle.index].ptr) : 0;
+}
+
+size_t CompactingSimpleAllocator::Compact(size_t budget) noexcept {
+  return allocator_.Compact(budget, {ClassifyBlock, MoveHandle, this});
+}
+
+// A block is live if the entry of the index in its header points back at it, free blocks have index 0
+BlockRelocator::BlockUse CompactingSimpleAllocator::ClassifyBlock(void *ptr, void *context) noexcept {
+  const auto *allocator = static_cast<const CompactingSimpleAllocator *>(context);
+  const size_t index = MemoryBlock::FromUserMemory(ptr)->GetHandleIndex();
+  if (!index || index >= allocator->handles_used_ || allocator->handles_[index].ptr != ptr) {
+    return BlockRelocator::BlockUse::UNUSED;
+  }
+  return allocator->handles_[index].pins ? BlockRelocator::BlockUse::PINNED : BlockRelocator::BlockUse::MOVABLE;
+}
+
+void CompactingSimpleAllocator::MoveHandle(void *, void *to, void *context) noexcept {
+  auto *allocator = static_cast<CompactingSimpleAllocator *>(context);
+  allocator->handles_[MemoryBlock::FromUserMemory(to)->GetHandleIndex()].ptr = to;
+}
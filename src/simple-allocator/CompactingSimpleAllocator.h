@@ -0,0 +1,70 @@
+// Simple Allocator 2024
+#ifndef COMPACTINGSIMPLEALLOCATOR_H
+#define COMPACTINGSIMPLEALLOCATOR_H
+#include "SimpleAllocator.h"
+
+#include <cstdint>
+
+// Reference to a block of a CompactingSimpleAllocator, which stays valid while the compaction moves the block
+struct Handle {
+  uint32_t index{0};
+
+  explicit operator bool() const noexcept {
+    return index;
+  }
+};
+
+// SimpleAllocator whose blocks are reached through handles only, so they can be moved: Compact slides the unpinned blocks
+// toward the beginning of the buffer and the freed space comes back as bump memory at the end of a pass, which in-place reuse
+// of free blocks can't do for a heap of churning objects. A pointer to the memory is valid between Pin and Unpin.
+// Not thread-safe, like SimpleAllocator.
+class CompactingSimpleAllocator {
+public:
+  CompactingSimpleAllocator() = default;
+  // The handle table takes the beginning of the buffer, a null handle is returned once max_handles are allocated
+  bool Init(void *buffer, size_t buffer_size, size_t max_handles) noexcept;
+
+  Handle Allocate(size_t size) noexcept;
+  void Deallocate(Handle handle) noexcept;
+
+  // The memory of the block, which stays in place until as many Unpin calls as Pin calls were made
+  void *Pin(Handle handle) noexcept;
+  void Unpin(Handle handle) noexcept;
+  size_t Size(Handle handle) const noexcept;
+
+  // A step of at most about budget bytes moved, see SimpleAllocator::Compact. Returns the bytes moved.
+  size_t Compact(size_t budget) noexcept;
+
+  bool IsCompacting() const noexcept {
+    return allocator_.IsCompacting();
+  }
+
+  // Bytes cut from the buffer after the handle table
+  size_t HeapExtent() const noexcept {
+    return allocator_.HeapExtent();
+  }
+
+  bool Validate() noexcept {
+    return allocator_.Validate();
+  }
+
+private:
+  // A free entry keeps the index of the next free one instead of memory
+  struct HandleEntry {
+    void *ptr;
+    uint32_t pins;
+    uint32_t next_free;
+  };
+
+  static BlockRelocator::BlockUse ClassifyBlock(void *ptr, void *context) noexcept;
+  static void MoveHandle(void *from, void *to, void *context) noexcept;
+
+  SimpleAllocator allocator_;
+  // Entry 0 stands for the null handle, the entries up to handles_used_ were handed out at least once
+  HandleEntry *handles_{nullptr};
+  size_t max_handles_{0};
+  size_t handles_used_{1};
+  uint32_t free_handles_{0};
+};
+
+#endif // COMPACTINGSIMPLEALLOCATOR_H
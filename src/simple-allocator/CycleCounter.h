@@ -0,0 +1,24 @@
+// Simple Allocator 2024
+#ifndef CYCLECOUNTER_H
+#define CYCLECOUNTER_H
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Returns the cheapest monotonic tick counter of the CPU: TSC on x86, the virtual counter on arm64.
+inline uint64_t ReadCycleCounter() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+#endif // CYCLECOUNTER_H
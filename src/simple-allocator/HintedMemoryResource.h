@@ -0,0 +1,40 @@
+// Simple Allocator 2024
+#ifndef HINTEDMEMORYRESOURCE_H
+#define HINTEDMEMORYRESOURCE_H
+#include "HintedSimpleAllocator.h"
+#include "SimpleAllocatorTraits.h"
+
+#include <memory_resource>
+#include <new>
+
+// std::pmr adapter which allocates with one hint, e.g. the resource of a per-request container is short-lived.
+// Resources over the same allocator are equal whatever their hints are: any of them can free a block of another.
+class HintedMemoryResource final : public std::pmr::memory_resource {
+public:
+  HintedMemoryResource(HintedSimpleAllocator &allocator, AllocationHint hint) noexcept
+    : allocator_(allocator)
+    , hint_(hint) {}
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) final {
+    void *ptr = alignment <= SimpleAllocatorTraits::ALIGNMENT ? allocator_.Allocate(bytes ? bytes : 1, hint_) : nullptr;
+    if (!ptr) {
+      throw std::bad_alloc{};
+    }
+    return ptr;
+  }
+
+  void do_deallocate(void *ptr, size_t, size_t) final {
+    allocator_.Deallocate(ptr);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept final {
+    const auto *other_resource = dynamic_cast<const HintedMemoryResource *>(&other);
+    return other_resource && &other_resource->allocator_ == &allocator_;
+  }
+
+  HintedSimpleAllocator &allocator_;
+  AllocationHint hint_;
+};
+
+#endif // HINTEDMEMORYRESOURCE_H
@@ -0,0 +1,58 @@
+// Simple Allocator 2024
+#include "HintedSimpleAllocator.h"
+
+#include "SimpleAllocatorTraits.h"
+
+bool HintedSimpleAllocator::Init(void *buffer, size_t buffer_size) noexcept {
+  if (region_begins_[0]) {
+    return false;
+  }
+
+  const size_t region_size = buffer_size / REGIONS_COUNT / SimpleAllocatorTraits::ALIGNMENT * SimpleAllocatorTraits::ALIGNMENT;
+  auto *region_begin = static_cast<uint8_t *>(buffer);
+  for (size_t i = 0; i != REGIONS_COUNT; ++i, region_begin += region_size) {
+    if (!regions_[i].Init(region_begin, region_size)) {
+      regions_ = {};
+      region_begins_ = {};
+      return false;
+    }
+    region_begins_[i] = region_begin;
+  }
+  return true;
+}
+
+void *HintedSimpleAllocator::Allocate(size_t size, AllocationHint hint) noexcept {
+  return regions_[static_cast<size_t>(hint)].Allocate(size);
+}
+
+void HintedSimpleAllocator::Deallocate(void *ptr) noexcept {
+  if (ptr) {
+    GetRegion(ptr).Deallocate(ptr);
+  }
+}
+
+void *HintedSimpleAllocator::Reallocate(void *ptr, size_t new_size) noexcept {
+  return ptr ? GetRegion(ptr).Reallocate(ptr, new_size) : Allocate(new_size);
+}
+
+size_t HintedSimpleAllocator::Size(void *ptr) noexcept {
+  return SimpleAllocator::Size(ptr);
+}
+
+size_t HintedSimpleAllocator::HeapExtent() const noexcept {
+  size_t heap_extent = 0;
+  for (const auto &region : regions_) {
+    heap_extent += region.HeapExtent();
+  }
+  return heap_extent;
+}
+
+size_t HintedSimpleAllocator::HeapExtent(AllocationHint hint) const noexcept {
+  return regions_[static_cast<size_t>(hint)].HeapExtent();
+}
+
+SimpleAllocator &HintedSimpleAllocator::GetRegion(const void *ptr) noexcept {
+  static_assert(REGIONS_COUNT == 3);
+  const auto *address = static_cast<const uint8_t *>(ptr);
+  return regions_[address >= region_begins_[2] ? 2 : address >= region_begins_[1] ? 1 : 0];
+}
@@ -0,0 +1,44 @@
+// Simple Allocator 2024
+#ifndef HINTEDSIMPLEALLOCATOR_H
+#define HINTEDSIMPLEALLOCATOR_H
+#include "SimpleAllocator.h"
+
+#include <array>
+#include <cstdint>
+
+// Expected lifetime or kind of an allocation, every hint gets its own region
+enum class AllocationHint : uint8_t {
+  LONG_LIVED,
+  SHORT_LIVED,
+  BULK,
+  COUNT
+};
+
+// SimpleAllocator with a separate bump region, slots and tree per hint, so a few long-lived survivors
+// don't pin memory between short-lived blocks. The buffer is split into equal regions,
+// Deallocate and Reallocate find the region of a block by its address.
+class HintedSimpleAllocator {
+public:
+  HintedSimpleAllocator() = default;
+  bool Init(void *buffer, size_t buffer_size) noexcept;
+
+  // Allocations without a hint are long-lived
+  [[gnu::malloc]] [[gnu::alloc_size(2)]] void *Allocate(size_t size, AllocationHint hint = AllocationHint::LONG_LIVED) noexcept;
+  void Deallocate(void *ptr) noexcept;
+  // The block stays in the region it was allocated from
+  [[gnu::alloc_size(3)]] void *Reallocate(void *ptr, size_t new_size) noexcept;
+  static size_t Size(void *ptr) noexcept;
+
+  size_t HeapExtent() const noexcept;
+  size_t HeapExtent(AllocationHint hint) const noexcept;
+
+private:
+  static constexpr size_t REGIONS_COUNT = static_cast<size_t>(AllocationHint::COUNT);
+
+  SimpleAllocator &GetRegion(const void *ptr) noexcept;
+
+  std::array<SimpleAllocator, REGIONS_COUNT> regions_{};
+  std::array<const uint8_t *, REGIONS_COUNT> region_begins_{};
+};
+
+#endif // HINTEDSIMPLEALLOCATOR_H
@@ -0,0 +1,162 @@
+// Simple Allocator 2024
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of cycle counts: every power of two range is split into SUB_BUCKETS equal buckets,
+// so a percentile is off by at most 1/SUB_BUCKETS of its value.
+class LatencyHistogram {
+public:
+  static constexpr size_t SUB_BUCKET_BITS = 4;
+  static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+  // Values from 2^(MAX_EXPONENT + 1) cycles on fall into the last bucket
+  static constexpr size_t MAX_EXPONENT = 40;
+  static constexpr size_t BUCKETS_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  static constexpr size_t GetBucketIndex(uint64_t value) noexcept {
+    if (value < SUB_BUCKETS) {
+      return static_cast<size_t>(value);
+    }
+    const size_t exponent = static_cast<size_t>(std::bit_width(value)) - 1;
+    if (exponent > MAX_EXPONENT) {
+      return BUCKETS_COUNT - 1;
+    }
+    const size_t shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+  }
+
+  static constexpr uint64_t GetBucketLowerBound(size_t index) noexcept {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+    const size_t shift = index / SUB_BUCKETS - 1;
+    return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  }
+
+  static constexpr uint64_t GetBucketUpperBound(size_t index) noexcept {
+    return index < SUB_BUCKETS ? index : GetBucketLowerBound(index) + (uint64_t{1} << (index / SUB_BUCKETS - 1)) - 1;
+  }
+
+  void Record(uint64_t value) noexcept {
+    ++buckets_[GetBucketIndex(value)];
+    ++count_;
+    max_ = std::max(max_, value);
+  }
+
+  void Merge(const LatencyHistogram &other) noexcept {
+    for (size_t i = 0; i != BUCKETS_COUNT; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  void Reset() noexcept {
+    *this = LatencyHistogram{};
+  }
+
+  uint64_t Count() const noexcept {
+    return count_;
+  }
+
+  uint64_t Max() const noexcept {
+    return max_;
+  }
+
+  // Upper bound of the bucket holding the percentile (0, 100], zero if nothing is recorded
+  uint64_t Percentile(double percentile) const noexcept {
+    if (!count_) {
+      return 0;
+    }
+    const auto rank = std::clamp(static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count_))), uint64_t{1}, count_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i != BUCKETS_COUNT; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(GetBucketUpperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  std::array<uint64_t, BUCKETS_COUNT> buckets_{};
+  uint64_t count_{0};
+  uint64_t max_{0};
+};
+
+// The way an allocator call was served, each one has its own histogram
+enum class AllocationPath : uint8_t {
+  SLOT_HIT,
+  SLOT_MISS,
+  BIN_HIT,
+  TREE_HIT,
+  TREE_HIT_SPLIT,
+  TREE_MISS,
+  DEALLOCATE,
+  REALLOCATE_IN_PLACE,
+  REALLOCATE_MOVE,
+  COUNT
+};
+
+constexpr const char *GetAllocationPathName(AllocationPath path) noexcept {
+  constexpr std::array<const char *, static_cast<size_t>(AllocationPath::COUNT)> names{
+    "slot_hit", "slot_miss", "bin_hit", "tree_hit", "tree_hit_split", "tree_miss", "deallocate", "reallocate_in_place", "reallocate_move"};
+  return names[static_cast<size_t>(path)];
+}
+
+// Histograms of every allocation path, with one of SamplingPeriod() calls being timed on average.
+// The distance between samples is randomized, so it can't lock onto a periodic workload.
+class LatencyHistograms {
+public:
+  static constexpr uint32_t DEFAULT_SAMPLING_PERIOD = 64;
+
+  bool ShouldSample() noexcept {
+    if (--countdown_) [[likely]] {
+      return false;
+    }
+    // xorshift32, the next distance is uniform in [1, 2 * period - 1]
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    countdown_ = 1 + random_ % (2 * sampling_period_ - 1);
+    return true;
+  }
+
+  void Record(AllocationPath path, uint64_t cycles) noexcept {
+    histograms_[static_cast<size_t>(path)].Record(cycles);
+  }
+
+  const LatencyHistogram &Get(AllocationPath path) const noexcept {
+    return histograms_[static_cast<size_t>(path)];
+  }
+
+  uint32_t SamplingPeriod() const noexcept {
+    return sampling_period_;
+  }
+
+  // Period 1 times every call
+  void SetSamplingPeriod(uint32_t sampling_period) noexcept {
+    sampling_period_ = std::max(sampling_period, uint32_t{1});
+    countdown_ = sampling_period_;
+  }
+
+  void Reset() noexcept {
+    for (auto &histogram : histograms_) {
+      histogram.Reset();
+    }
+  }
+
+private:
+  std::array<LatencyHistogram, static_cast<size_t>(AllocationPath::COUNT)> histograms_{};
+  uint32_t sampling_period_{DEFAULT_SAMPLING_PERIOD};
+  uint32_t countdown_{DEFAULT_SAMPLING_PERIOD};
+  uint32_t random_{0x9E3779B9};
+};
+
+#endif // LATENCYHISTOGRAM_H
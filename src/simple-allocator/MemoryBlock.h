@@ -10,7 +10,7 @@
 class MemoryBlock {
 public:
   constexpr explicit MemoryBlock(size_t size) noexcept
-    : metadata{size} {}
+    : metadata{size, 0} {}
 
   uint8_t *UserMemoryBegin() noexcept {
     return reinterpret_cast<uint8_t *>(this + 1);
@@ -28,6 +28,39 @@ public:
     metadata.size = size;
   }
 
+  // A heap walk marks free blocks with the low bit of the size, the alignment keeps it clear otherwise
+  static constexpr size_t WALK_MARK{1};
+
+  constexpr bool IsMarked() const noexcept {
+    return metadata.size & WALK_MARK;
+  }
+
+  constexpr void SetMarked(bool marked) noexcept {
+    metadata.size = (metadata.size & ~WALK_MARK) | (marked ? WALK_MARK : 0);
+  }
+
+  constexpr size_t GetUnmarkedBlockSize() const noexcept {
+    return metadata.size & ~WALK_MARK;
+  }
+
+  // Times Reallocate moved the memory of the block to grow it, in the padding of the header. Zero once the block is freed.
+  constexpr size_t GetGrowthMoves() const noexcept {
+    return metadata.growth_moves;
+  }
+
+  constexpr void SetGrowthMoves(size_t growth_moves) noexcept {
+    metadata.growth_moves = growth_moves;
+  }
+
+  // A block of a CompactingSimpleAllocator is never reallocated, the same word keeps the index of its handle. Zero once the block is freed.
+  constexpr size_t GetHandleIndex() const noexcept {
+    return metadata.growth_moves;
+  }
+
+  constexpr void SetHandleIndex(size_t handle_index) noexcept {
+    metadata.growth_moves = handle_index;
+  }
+
   static constexpr MemoryBlock *FromUserMemory(void *ptr) noexcept {
     return static_cast<MemoryBlock *>(ptr) - 1;
   }
@@ -35,6 +68,7 @@ public:
 private:
   struct alignas(SimpleAllocatorTraits::ALIGNMENT) {
     size_t size;
+    size_t growth_moves;
   } metadata;
 };
 
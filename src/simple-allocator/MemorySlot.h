@@ -11,16 +11,55 @@ public:
   constexpr MemorySlot() = default;
 
   MemoryBlock *GetNext() noexcept {
+    if (void *memory = Pop()) {
+      return MemoryBlock::FromUserMemory(memory);
+    }
+    return nullptr;
+  }
+
+  void AddNext(MemoryBlock *memory_block) noexcept {
+    Push(memory_block->UserMemoryBegin());
+  }
+
+  // Raw memory, for pieces without a MemoryBlock header
+  void *Pop() noexcept {
     if (next_) {
       auto *next = next_;
       next_ = next->next_;
-      return MemoryBlock::FromUserMemory(next);
+      return next;
     }
     return nullptr;
   }
 
-  void AddNext(MemoryBlock *memory_block) noexcept {
-    next_ = new (memory_block->UserMemoryBegin()) MemorySlot{next_};
+  void Push(void *memory) noexcept {
+    next_ = new (memory) MemorySlot{next_};
+  }
+
+  bool IsEmpty() const noexcept {
+    return !next_;
+  }
+
+  // Unlinks the memory for which the predicate is true, the rest keeps its order
+  template<class Predicate>
+  void RemoveIf(Predicate &&predicate) noexcept {
+    for (MemorySlot **link = &next_; *link;) {
+      if (predicate(static_cast<void *>(*link))) {
+        *link = (*link)->next_;
+      } else {
+        link = &(*link)->next_;
+      }
+    }
+  }
+
+  // Calls the visitor for the memory in the list before reading its link, a visitor returning false stops the walk
+  template<class Visitor>
+  bool ForEach(Visitor &&visitor) const noexcept {
+    for (MemorySlot *next = next_; next; next = next->next_) {
+      if (!visitor(static_cast<void *>(next))) {
+        return false;
+      }
+    }
+    return true;
   }
 
 private:
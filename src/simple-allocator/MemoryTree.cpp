@@ -4,6 +4,8 @@
 #include "MemoryBlock.h"
 
 #include <cassert>
+#include <cstdint>
+#include <limits>
 #include <new>
 #include <utility>
 
@@ -98,6 +100,46 @@ MemoryBlock *MemoryTree::RetrieveBlock(size_t size) noexcept {
   return nullptr;
 }
 
+bool MemoryTree::RemoveBlock(MemoryBlock *memory_block) noexcept {
+  auto *removed_node = reinterpret_cast<TreeNode *>(memory_block->UserMemoryBegin());
+  TreeNode *v = LookupNode(memory_block->GetBlockSize(), false);
+  if (!v || v->block_size != memory_block->GetBlockSize()) {
+    return false;
+  }
+  if (v != removed_node) {
+    for (TreeNode **link = &v->same_size_nodes; *link; link = &(*link)->same_size_nodes) {
+      if (*link == removed_node) {
+        *link = removed_node->same_size_nodes;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  TreeNode *replacer = v->same_size_nodes;
+  if (!replacer) {
+    DetachNode(v);
+    return true;
+  }
+  // The next block of the size takes the place of the node, the shape of the tree stays
+  replacer->left = v->left;
+  replacer->right = v->right;
+  replacer->parent = v->parent;
+  replacer->color = v->color;
+  if (v->left) {
+    v->left->parent = replacer;
+  }
+  if (v->right) {
+    v->right->parent = replacer;
+  }
+  if (v->parent) {
+    v->ReplaceSelfOnParent(replacer);
+  } else {
+    root_ = replacer;
+  }
+  return true;
+}
+
 MemoryTree::TreeNode *MemoryTree::LookupNode(size_t size, bool lower_bound) const noexcept {
   TreeNode *node = root_;
   TreeNode *lower_bound_node = nullptr;
@@ -340,3 +382,82 @@ void MemoryTree::LeftRotate(TreeNode *node) noexcept {
 
   new_parent->left = node;
 }
+
+bool MemoryTree::ForEachBlock(bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) const noexcept {
+  return ForEachNodeBlock(root_, visitor, context);
+}
+
+bool MemoryTree::ForEachNodeBlock(const TreeNode *node, bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) noexcept {
+  if (!node) {
+    return true;
+  }
+  if (!ForEachNodeBlock(node->left, visitor, context)) {
+    return false;
+  }
+  for (const TreeNode *same_size_node = node; same_size_node; same_size_node = same_size_node->same_size_nodes) {
+    if (!visitor(MemoryBlock::FromUserMemory(const_cast<TreeNode *>(same_size_node)), context)) {
+      return false;
+    }
+  }
+  return ForEachNodeBlock(node->right, visitor, context);
+}
+
+struct MemoryTree::ValidationState {
+  const uint8_t *begin;
+  const uint8_t *end;
+  size_t blocks_left;
+
+  // Whether the node is the user memory of a block in the heap with the size of the node, and one more block fits the limit
+  bool IsBlock(const TreeNode *node) noexcept {
+    const auto *memory = reinterpret_cast<const uint8_t *>(node);
+    if (!blocks_left || memory < begin + sizeof(MemoryBlock) || memory + sizeof(TreeNode) > end ||
+        reinterpret_cast<uintptr_t>(memory) % SimpleAllocatorTraits::ALIGNMENT) {
+      return false;
+    }
+    --blocks_left;
+    const size_t block_size = MemoryBlock::FromUserMemory(const_cast<TreeNode *>(node))->GetBlockSize();
+    return block_size == node->block_size && block_size <= static_cast<size_t>(end - memory);
+  }
+};
+
+bool MemoryTree::Validate(const void *begin, const void *end, size_t max_blocks) const noexcept {
+  ValidationState state{static_cast<const uint8_t *>(begin), static_cast<const uint8_t *>(end), max_blocks};
+  if (!root_) {
+    return true;
+  }
+  size_t black_height = 0;
+  return !root_->parent && root_->color == TreeNode::BLACK && ValidateNode(root_, 0, std::numeric_limits<size_t>::max(), black_height, state);
+}
+
+// Sizes of the subtree must be within (min_size, max_size), black_height is the number of black nodes on every path down from the node
+bool MemoryTree::ValidateNode(const TreeNode *node, size_t min_size, size_t max_size, size_t &black_height, ValidationState &state) noexcept {
+  if (!node) {
+    black_height = 1;
+    return true;
+  }
+  if (!state.IsBlock(node) || node->block_size <= min_size || node->block_size >= max_size) {
+    return false;
+  }
+  if (node->color != TreeNode::RED && node->color != TreeNode::BLACK) {
+    return false;
+  }
+  for (const TreeNode *child : {node->left, node->right}) {
+    if (child && (child->parent != node || (node->color == TreeNode::RED && child->color == TreeNode::RED))) {
+      return false;
+    }
+  }
+  for (const TreeNode *same_size_node = node->same_size_nodes; same_size_node; same_size_node = same_size_node->same_size_nodes) {
+    if (!state.IsBlock(same_size_node) || same_size_node->block_size != node->block_size) {
+      return false;
+    }
+  }
+
+  size_t left_black_height = 0;
+  size_t right_black_height = 0;
+  if (!ValidateNode(node->left, min_size, node->block_size, left_black_height, state) ||
+      !ValidateNode(node->right, node->block_size, max_size, right_black_height, state) || left_black_height != right_black_height) {
+    return false;
+  }
+  black_height = left_black_height + (node->color == TreeNode::BLACK);
+  return true;
+}
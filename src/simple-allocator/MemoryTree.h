@@ -9,9 +9,23 @@ class MemoryTree {
 public:
   void InsertBlock(MemoryBlock *memory_block) noexcept;
   MemoryBlock *RetrieveBlock(size_t size) noexcept;
+  // Takes the given block out of the tree, false if it isn't there
+  bool RemoveBlock(MemoryBlock *memory_block) noexcept;
+
+  // Calls the visitor for every block in the tree in the order of sizes, a visitor returning false stops the walk.
+  // Returns false if the walk was stopped.
+  bool ForEachBlock(bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) const noexcept;
+
+  // Checks the red-black invariants, parent links, the order of sizes and that every node is a block of the heap
+  // between begin and end, which has the size of the node. A cycle is caught by at most max_blocks blocks in the tree.
+  bool Validate(const void *begin, const void *end, size_t max_blocks) const noexcept;
 
 private:
   class TreeNode;
+  struct ValidationState;
+
+  static bool ForEachNodeBlock(const TreeNode *node, bool (*visitor)(MemoryBlock *memory_block, void *context), void *context) noexcept;
+  static bool ValidateNode(const TreeNode *node, size_t min_size, size_t max_size, size_t &black_height, ValidationState &state) noexcept;
 
   TreeNode *LookupNode(size_t size, bool lower_bound) const noexcept;
 
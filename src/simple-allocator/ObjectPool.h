@@ -0,0 +1,84 @@
+// Simple Allocator 2024
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+#include "MemorySlot.h"
+#include "SimpleAllocator.h"
+#include "SimpleAllocatorTraits.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+// Fixed-size pool for one object type on top of a SimpleAllocator.
+// Objects have no MemoryBlock header, free ones are linked by the MemorySlot free list,
+// and refills are carved from the allocator in contiguous batches, so objects allocated together are adjacent.
+template<class T, size_t BATCH_SIZE = 64>
+class ObjectPool {
+public:
+  static_assert(alignof(T) <= SimpleAllocatorTraits::ALIGNMENT, "over-aligned types are not supported");
+  static_assert(BATCH_SIZE > 0);
+
+  static constexpr size_t OBJECT_ALIGNMENT = std::max(alignof(T), alignof(MemorySlot));
+  static constexpr size_t OBJECT_SIZE = (std::max(sizeof(T), sizeof(MemorySlot)) + OBJECT_ALIGNMENT - 1) / OBJECT_ALIGNMENT * OBJECT_ALIGNMENT;
+
+  explicit ObjectPool(SimpleAllocator &allocator) noexcept
+    : allocator_(allocator) {}
+
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  void *Allocate() noexcept {
+    if (void *memory = free_objects_.Pop()) [[likely]] {
+      return memory;
+    }
+    return Refill();
+  }
+
+  void Deallocate(void *memory) noexcept {
+    free_objects_.Push(memory);
+  }
+
+  template<class... Args>
+  T *Construct(Args &&...args) {
+    void *memory = Allocate();
+    return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+  }
+
+  void Destroy(T *object) noexcept {
+    object->~T();
+    Deallocate(object);
+  }
+
+  // Returns all batches to the allocator, objects must be destroyed by then
+  ~ObjectPool() noexcept {
+    while (batches_) {
+      allocator_.Deallocate(std::exchange(batches_, batches_->next));
+    }
+  }
+
+private:
+  struct alignas(SimpleAllocatorTraits::ALIGNMENT) Batch {
+    Batch *next;
+  };
+
+  [[gnu::noinline]] void *Refill() noexcept {
+    void *memory = allocator_.Allocate(sizeof(Batch) + BATCH_SIZE * OBJECT_SIZE);
+    if (!memory) {
+      return nullptr;
+    }
+
+    batches_ = new (memory) Batch{batches_};
+    auto *objects = reinterpret_cast<uint8_t *>(batches_ + 1);
+    // Pushed backwards, so objects are handed out in address order
+    for (size_t i = BATCH_SIZE - 1; i != 0; --i) {
+      free_objects_.Push(objects + i * OBJECT_SIZE);
+    }
+    return objects;
+  }
+
+  SimpleAllocator &allocator_;
+  MemorySlot free_objects_;
+  Batch *batches_{nullptr};
+};
+
+#endif // OBJECTPOOL_H
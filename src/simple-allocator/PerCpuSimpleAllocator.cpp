@@ -0,0 +1,274 @@
+// Simple Allocator 2024
+#include "PerCpuSimpleAllocator.h"
+
+#include "MemoryBlock.h"
+#include "SimpleAllocatorTraits.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define SIMPLE_ALLOCATOR_RSEQ
+#endif
+
+namespace {
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// The list of the slot on the current CPU is at caches + cpu * stride + head_offset
+struct CacheLayout {
+  uint8_t *caches;
+  size_t stride;
+  size_t cpus;
+};
+
+#ifdef SIMPLE_ALLOCATOR_RSEQ
+// The registration of the thread, glibc keeps it at a fixed offset from the thread pointer
+struct rseq *CurrentRseq() noexcept {
+  return reinterpret_cast<struct rseq *>(static_cast<uint8_t *>(__builtin_thread_pointer()) + __rseq_offset);
+}
+
+// A critical section runs from label 1 to label 2, the last instruction in it is the store which commits it.
+// The kernel moves a thread preempted, migrated or signalled inside it to label 4, which arms the section again and restarts it.
+// The abort handler is preceded by the signature glibc registered, hidden in an undefined instruction as in librseq.
+#define RSEQ_CRITICAL_SECTION_BEGIN                      \
+  ".pushsection __rseq_cs, \"aw\"\n\t"                   \
+  ".balign 32\n\t"                                       \
+  "3:\n\t"                                               \
+  ".long 0, 0\n\t"                                       \
+  ".quad 1f, (2f - 1f), 4f\n\t"                          \
+  ".popsection\n\t"                                      \
+  "6:\n\t"                                               \
+  "leaq 3b(%%rip), %%rcx\n\t"                            \
+  "movq %%rcx, %[rseq_cs]\n\t"                           \
+  "1:\n\t"
+
+#define RSEQ_CRITICAL_SECTION_END                        \
+  "2:\n\t"                                               \
+  ".pushsection __rseq_failure, \"ax\"\n\t"              \
+  ".byte 0x0f, 0xb9, 0x3d\n\t"                           \
+  ".long 0x53053053\n\t"                                 \
+  "4:\n\t"                                               \
+  "jmp 6b\n\t"                                           \
+  ".popsection\n\t"
+
+static_assert(RSEQ_SIG == 0x53053053);
+
+// Pops a block from the cache of the current CPU, nullptr if it is empty or the CPU has none
+void *PopCpuCache(const CacheLayout &layout, size_t head_offset) noexcept {
+  struct rseq *rseq = CurrentRseq();
+  void *head;
+  asm volatile(RSEQ_CRITICAL_SECTION_BEGIN
+               "xorl %k[head], %k[head]\n\t"
+               "movl %[cpu_id], %%ecx\n\t"
+               "cmpq %[cpus], %%rcx\n\t"
+               "jae 2f\n\t"
+               "imulq %[stride], %%rcx\n\t"
+               "addq %[caches], %%rcx\n\t"
+               "movq (%%rcx, %[head_offset]), %[head]\n\t"
+               "testq %[head], %[head]\n\t"
+               "jz 2f\n\t"
+               "movq (%[head]), %%rdx\n\t"
+               "movq %%rdx, (%%rcx, %[head_offset])\n\t" RSEQ_CRITICAL_SECTION_END
+               : [head] "=&r"(head), [rseq_cs] "=m"(rseq->rseq_cs)
+               : [cpu_id] "m"(rseq->cpu_id), [cpus] "r"(layout.cpus), [stride] "r"(layout.stride), [caches] "r"(layout.caches),
+                 [head_offset] "r"(head_offset)
+               : "rcx", "rdx", "memory", "cc");
+  return head;
+}
+
+// Pushes a block to the cache of the current CPU, false if the list holds its capacity already or the CPU has no cache.
+// The block keeps the link and the length of the list from it on, so a push reads only the head.
+bool PushCpuCache(const CacheLayout &layout, size_t head_offset, void *memory, size_t capacity) noexcept {
+  struct rseq *rseq = CurrentRseq();
+  uint32_t pushed;
+  asm volatile(RSEQ_CRITICAL_SECTION_BEGIN
+               "xorl %[pushed], %[pushed]\n\t"
+               "movl %[cpu_id], %%ecx\n\t"
+               "cmpq %[cpus], %%rcx\n\t"
+               "jae 2f\n\t"
+               "imulq %[stride], %%rcx\n\t"
+               "addq %[caches], %%rcx\n\t"
+               "movq (%%rcx, %[head_offset]), %%rdx\n\t"
+               "xorl %%eax, %%eax\n\t"
+               "testq %%rdx, %%rdx\n\t"
+               "jz 5f\n\t"
+               "movq 8(%%rdx), %%rax\n\t"
+               "5:\n\t"
+               "cmpq %[capacity], %%rax\n\t"
+               "jae 2f\n\t"
+               "movq %%rdx, (%[memory])\n\t"
+               "incq %%rax\n\t"
+               "movq %%rax, 8(%[memory])\n\t"
+               "movl $1, %[pushed]\n\t"
+               "movq %[memory], (%%rcx, %[head_offset])\n\t" RSEQ_CRITICAL_SECTION_END
+               : [pushed] "=&r"(pushed), [rseq_cs] "=m"(rseq->rseq_cs)
+               : [cpu_id] "m"(rseq->cpu_id), [cpus] "r"(layout.cpus), [stride] "r"(layout.stride), [caches] "r"(layout.caches),
+                 [head_offset] "r"(head_offset), [memory] "r"(memory), [capacity] "r"(capacity)
+               : "rax", "rcx", "rdx", "memory", "cc");
+  return pushed;
+}
+#else
+// Without rseq there are no caches, Init leaves them off
+void *PopCpuCache(const CacheLayout &, size_t) noexcept {
+  return nullptr;
+}
+
+bool PushCpuCache(const CacheLayout &, size_t, void *, size_t) noexcept {
+  return false;
+}
+#endif
+
+} // namespace
+
+class PerCpuSimpleAllocator::ScopedLock {
+public:
+  explicit ScopedLock(std::atomic<uint32_t> &lock) noexcept
+    : lock_(lock) {
+    while (lock_.exchange(1, std::memory_order_acquire)) {
+      while (lock_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  ~ScopedLock() noexcept {
+    lock_.store(0, std::memory_order_release);
+  }
+
+private:
+  std::atomic<uint32_t> &lock_;
+};
+
+bool PerCpuSimpleAllocator::Init(void *buffer, size_t buffer_size, bool use_rseq) noexcept {
+  if (!allocator_.Init(buffer, buffer_size)) {
+    return false;
+  }
+  for (size_t slot_index = 0; slot_index != cache_capacities_.size(); ++slot_index) {
+    cache_capacities_[slot_index] = static_cast<uint32_t>(std::max<size_t>(SimpleAllocatorTraits::PER_CPU_CACHE_SIZE / GetSlotSize(slot_index), 1));
+  }
+
+#ifdef SIMPLE_ALLOCATOR_RSEQ
+  const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if (!use_rseq || !__rseq_size || cpus <= 0) {
+    return true;
+  }
+  // A line of its own for the heads of every CPU, the caches stay off if the buffer has no room for them
+  const size_t stride = AlignN<CACHE_LINE_SIZE>(SizeClasses::COUNT * sizeof(void *));
+  const size_t caches_size = static_cast<size_t>(cpus) * stride;
+  auto *memory = static_cast<uint8_t *>(allocator_.Allocate(caches_size + CACHE_LINE_SIZE));
+  if (memory) {
+    cpu_caches_ = reinterpret_cast<uint8_t *>(AlignN<CACHE_LINE_SIZE>(reinterpret_cast<uintptr_t>(memory)));
+    std::memset(cpu_caches_, 0, caches_size);
+    cpu_cache_stride_ = stride;
+    cpus_ = static_cast<size_t>(cpus);
+  }
+#else
+  (void)use_rseq;
+#endif
+  return true;
+}
+
+void *PerCpuSimpleAllocator::Allocate(size_t size) noexcept {
+  const size_t slot_index = GetRequestSlotIndex(size);
+  if (cpu_caches_ && size && slot_index < SizeClasses::COUNT) {
+    if (void *memory = PopCpuCache({cpu_caches_, cpu_cache_stride_, cpus_}, slot_index * sizeof(void *))) {
+      return memory;
+    }
+    return RefillCpuCache(slot_index);
+  }
+  ScopedLock lock{lock_};
+  return allocator_.Allocate(size);
+}
+
+void PerCpuSimpleAllocator::Deallocate(void *ptr) noexcept {
+  if (!ptr) {
+    return;
+  }
+  auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+  const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize());
+  if (cpu_caches_ && slot_index < SizeClasses::COUNT) {
+    // Cached blocks are allocated as far as the allocator knows, the growth of Reallocate is forgotten here
+    memory_block->SetGrowthMoves(0);
+    if (!PushCpuCache({cpu_caches_, cpu_cache_stride_, cpus_}, slot_index * sizeof(void *), ptr, cache_capacities_[slot_index])) {
+      DrainCpuCache(slot_index, memory_block);
+    }
+    return;
+  }
+  ScopedLock lock{lock_};
+  allocator_.Deallocate(ptr);
+}
+
+void *PerCpuSimpleAllocator::Reallocate(void *ptr, size_t new_size) noexcept {
+  if (!ptr) {
+    return Allocate(new_size);
+  }
+  if (!new_size) {
+    Deallocate(ptr);
+    return nullptr;
+  }
+  ScopedLock lock{lock_};
+  return allocator_.Reallocate(ptr, new_size);
+}
+
+size_t PerCpuSimpleAllocator::Size(void *ptr) noexcept {
+  return SimpleAllocator::Size(ptr);
+}
+
+size_t PerCpuSimpleAllocator::HeapExtent() noexcept {
+  ScopedLock lock{lock_};
+  return allocator_.HeapExtent();
+}
+
+// Takes half of the capacity under one lock, hands out the first block and caches the others on whatever CPU the thread is on by then
+void *PerCpuSimpleAllocator::RefillCpuCache(size_t slot_index) noexcept {
+  std::array<void *, SimpleAllocatorTraits::PER_CPU_CACHE_BATCH> blocks;
+  const size_t batch = std::clamp<size_t>(cache_capacities_[slot_index] / 2, 1, blocks.size());
+  size_t count = 0;
+  {
+    ScopedLock lock{lock_};
+    for (; count != batch; ++count) {
+      blocks[count] = allocator_.Allocate(GetSlotSize(slot_index));
+      if (!blocks[count]) {
+        break;
+      }
+    }
+  }
+  if (!count) {
+    return nullptr;
+  }
+
+  // Another thread may have filled the cache meanwhile, what doesn't fit goes back
+  const CacheLayout layout{cpu_caches_, cpu_cache_stride_, cpus_};
+  size_t cached = 1;
+  while (cached != count && PushCpuCache(layout, slot_index * sizeof(void *), blocks[cached], cache_capacities_[slot_index])) {
+    ++cached;
+  }
+  if (cached != count) {
+    ScopedLock lock{lock_};
+    for (; cached != count; ++cached) {
+      allocator_.Deallocate(blocks[cached]);
+    }
+  }
+  return blocks[0];
+}
+
+// The cache is full: the block and half of the cache go back under one lock
+void PerCpuSimpleAllocator::DrainCpuCache(size_t slot_index, MemoryBlock *memory_block) noexcept {
+  std::array<void *, SimpleAllocatorTraits::PER_CPU_CACHE_BATCH> blocks;
+  const size_t batch = std::clamp<size_t>(cache_capacities_[slot_index] / 2 + 1, 1, blocks.size());
+  const CacheLayout layout{cpu_caches_, cpu_cache_stride_, cpus_};
+  blocks[0] = memory_block->UserMemoryBegin();
+  size_t count = 1;
+  while (count != batch && (blocks[count] = PopCpuCache(layout, slot_index * sizeof(void *)))) {
+    ++count;
+  }
+
+  ScopedLock lock{lock_};
+  for (size_t i = 0; i != count; ++i) {
+    allocator_.Deallocate(blocks[i]);
+  }
+}
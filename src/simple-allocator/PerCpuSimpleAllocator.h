@@ -0,0 +1,53 @@
+// Simple Allocator 2024
+#ifndef PERCPUSIMPLEALLOCATOR_H
+#define PERCPUSIMPLEALLOCATOR_H
+#include "SimpleAllocator.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Thread-safe front-end of a SimpleAllocator for processes with many more threads than cores: blocks of the slot sizes
+// are cached per CPU instead of per thread, so the memory idling in caches grows with the cores, not the threads.
+// On Linux x86-64 the cache of the current CPU is popped and pushed in restartable sequences (rseq) registered by glibc,
+// without atomics or locks: a thread preempted or migrated in the middle of a sequence restarts it.
+// The caches are refilled from the SimpleAllocator and drained to it in batches under a spin lock, which also serves
+// the large blocks, Reallocate, and every call when rseq is unavailable.
+class PerCpuSimpleAllocator : SimpleAllocatorBase {
+public:
+  PerCpuSimpleAllocator() = default;
+  // The heads of the caches are taken from the buffer. Without use_rseq, or if glibc didn't register rseq,
+  // every call takes the lock.
+  bool Init(void *buffer, size_t buffer_size, bool use_rseq = true) noexcept;
+
+  [[gnu::malloc]] [[gnu::alloc_size(2)]] void *Allocate(size_t size) noexcept;
+  // Any thread may free a block, it goes to the cache of the CPU the thread runs on
+  void Deallocate(void *ptr) noexcept;
+  [[gnu::alloc_size(3)]] void *Reallocate(void *ptr, size_t new_size) noexcept;
+  static size_t Size(void *ptr) noexcept;
+
+  bool UsesCpuCaches() const noexcept {
+    return cpu_caches_;
+  }
+
+  // Bytes cut from the buffer, the cached blocks count as allocated
+  size_t HeapExtent() noexcept;
+
+private:
+  class ScopedLock;
+
+  void *RefillCpuCache(size_t slot_index) noexcept;
+  void DrainCpuCache(size_t slot_index, MemoryBlock *memory_block) noexcept;
+
+  SimpleAllocator allocator_;
+  std::atomic<uint32_t> lock_{0};
+
+  // Per CPU, the head of a list of cached blocks for every slot, a block keeps the length of the list from it on
+  uint8_t *cpu_caches_{nullptr};
+  size_t cpu_cache_stride_{0};
+  size_t cpus_{0};
+  // Blocks a CPU caches per slot, PER_CPU_CACHE_SIZE bytes of them
+  std::array<uint32_t, SizeClasses::COUNT> cache_capacities_{};
+};
+
+#endif // PERCPUSIMPLEALLOCATOR_H
@@ -0,0 +1,113 @@
+// Simple Allocator 2024
+#include "SharedMemorySegment.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool SharedMemorySegment::Create(const char *name, size_t size) noexcept {
+  if (fd_ != -1) {
+    return false;
+  }
+
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1) {
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) == -1 || !Map(fd, size)) {
+    close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  return true;
+}
+
+bool SharedMemorySegment::CreateAnonymous(size_t size) noexcept {
+  if (fd_ != -1) {
+    return false;
+  }
+
+#ifdef __linux__
+  const int fd = memfd_create("simple-allocator", MFD_CLOEXEC);
+#else
+  char name[64];
+  std::snprintf(name, sizeof(name), "/simple-allocator-%d-%p", static_cast<int>(getpid()), static_cast<void *>(this));
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd != -1) {
+    shm_unlink(name);
+  }
+#endif
+  if (fd == -1) {
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) == -1 || !Map(fd, size)) {
+    close(fd);
+    return false;
+  }
+  return true;
+}
+
+bool SharedMemorySegment::Open(const char *name) noexcept {
+  if (fd_ != -1) {
+    return false;
+  }
+
+  const int fd = shm_open(name, O_RDWR, 0600);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat fd_stat {};
+  if (fstat(fd, &fd_stat) == -1 || !Map(fd, static_cast<size_t>(fd_stat.st_size))) {
+    close(fd);
+    return false;
+  }
+  return true;
+}
+
+bool SharedMemorySegment::OpenFd(int fd) noexcept {
+  if (fd_ != -1) {
+    return false;
+  }
+
+  const int own_fd = dup(fd);
+  if (own_fd == -1) {
+    return false;
+  }
+  struct stat fd_stat {};
+  if (fstat(own_fd, &fd_stat) == -1 || !Map(own_fd, static_cast<size_t>(fd_stat.st_size))) {
+    close(own_fd);
+    return false;
+  }
+  return true;
+}
+
+bool SharedMemorySegment::Unlink(const char *name) noexcept {
+  return shm_unlink(name) == 0;
+}
+
+bool SharedMemorySegment::Map(int fd, size_t size) noexcept {
+  if (!size) {
+    return false;
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  fd_ = fd;
+  data_ = data;
+  size_ = size;
+  return true;
+}
+
+SharedMemorySegment::~SharedMemorySegment() noexcept {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
@@ -0,0 +1,48 @@
+// Simple Allocator 2024
+#ifndef SHAREDMEMORYSEGMENT_H
+#define SHAREDMEMORYSEGMENT_H
+#include <cstddef>
+#include <cstdint>
+
+// A MAP_SHARED mapping of a shm_open/memfd object. Every process maps the segment at its own address,
+// so anything stored inside must be linked by offsets rather than pointers.
+class SharedMemorySegment {
+public:
+  SharedMemorySegment() = default;
+  SharedMemorySegment(const SharedMemorySegment &) = delete;
+  SharedMemorySegment &operator=(const SharedMemorySegment &) = delete;
+
+  // Creates a new named segment, fails if the name is already taken.
+  bool Create(const char *name, size_t size) noexcept;
+  // Creates an unnamed segment, which can be shared by passing Fd() to another process.
+  bool CreateAnonymous(size_t size) noexcept;
+  // Maps an existing named segment.
+  bool Open(const char *name) noexcept;
+  // Maps an existing segment by a file descriptor, the descriptor is duplicated.
+  bool OpenFd(int fd) noexcept;
+
+  static bool Unlink(const char *name) noexcept;
+
+  void *Data() const noexcept {
+    return data_;
+  }
+
+  size_t Size() const noexcept {
+    return size_;
+  }
+
+  int Fd() const noexcept {
+    return fd_;
+  }
+
+  ~SharedMemorySegment() noexcept;
+
+private:
+  bool Map(int fd, size_t size) noexcept;
+
+  int fd_{-1};
+  void *data_{nullptr};
+  size_t size_{0};
+};
+
+#endif // SHAREDMEMORYSEGMENT_H
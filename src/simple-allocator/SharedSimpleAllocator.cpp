@@ -0,0 +1,245 @@
+// Simple Allocator 2024
+#include "SharedSimpleAllocator.h"
+
+#include "MemoryBlock.h"
+#include "SimpleAllocatorTraits.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#define SIMPLE_ALLOCATOR_ROBUST_LOCK
+#endif
+
+namespace {
+
+constexpr uint64_t SEGMENT_MAGIC = 0x53494d504c45534dULL;
+constexpr size_t LARGE_BINS = 48;
+
+#ifdef SIMPLE_ALLOCATOR_ROBUST_LOCK
+using SegmentLock = pthread_mutex_t;
+#else
+using SegmentLock = std::atomic<uint32_t>;
+#endif
+
+} // namespace
+
+struct SharedSimpleAllocator::SegmentHeader {
+  uint64_t magic{0};
+  SegmentLock lock{};
+  uint64_t end{0};
+  uint64_t current{0};
+  // The layout depends on the size classes, every process of a segment must be built with the same table
+  std::array<uint64_t, SizeClasses::COUNT> slots{};
+  std::array<uint64_t, LARGE_BINS> large_bins{};
+};
+
+#ifdef SIMPLE_ALLOCATOR_ROBUST_LOCK
+// A robust process-shared mutex: the kernel releases it when its owner dies, and the next process to lock it gets EOWNERDEAD.
+// The bump pointer and every list head change with a single aligned store, after the block linked in was written, so a process
+// killed in the middle of an operation leaves no list broken. It may leak blocks: the split path pops the block from its bin,
+// shrinks it and pushes the rest to another bin, and dying in between loses the block and the rest.
+class SharedSimpleAllocator::ScopedLock {
+public:
+  explicit ScopedLock(SegmentLock &lock) noexcept
+    : lock_(lock) {
+    if (pthread_mutex_lock(&lock_) == EOWNERDEAD) {
+      pthread_mutex_consistent(&lock_);
+    }
+  }
+
+  ~ScopedLock() noexcept {
+    pthread_mutex_unlock(&lock_);
+  }
+
+private:
+  SegmentLock &lock_;
+};
+#else
+// Without robust mutexes, a process which dies holding the lock stalls every other process of the segment
+class SharedSimpleAllocator::ScopedLock {
+public:
+  explicit ScopedLock(SegmentLock &lock) noexcept
+    : lock_(lock) {
+    while (lock_.exchange(1, std::memory_order_acquire)) {
+      while (lock_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  ~ScopedLock() noexcept {
+    lock_.store(0, std::memory_order_release);
+  }
+
+private:
+  SegmentLock &lock_;
+};
+#endif
+
+bool SharedSimpleAllocator::Create(void *segment, size_t segment_size) noexcept {
+  if (header_ || reinterpret_cast<uintptr_t>(segment) % SimpleAllocatorTraits::ALIGNMENT) {
+    return false;
+  }
+
+  const uint64_t heap_begin = AlignN<SimpleAllocatorTraits::ALIGNMENT>(sizeof(SegmentHeader));
+  const uint64_t heap_end = segment_size & ~(SimpleAllocatorTraits::ALIGNMENT - 1);
+  if (heap_begin >= heap_end) {
+    return false;
+  }
+
+  auto *header = new (segment) SegmentHeader{};
+#ifdef SIMPLE_ALLOCATOR_ROBUST_LOCK
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+  const int error = pthread_mutex_init(&header->lock, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+  if (error) {
+    return false;
+  }
+#else
+  static_assert(SegmentLock::is_always_lock_free, "process shared lock must be address free");
+#endif
+  header->end = heap_end;
+  header->current = heap_begin;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SEGMENT_MAGIC;
+  header_ = header;
+  return true;
+}
+
+bool SharedSimpleAllocator::Attach(void *segment) noexcept {
+  if (header_ || reinterpret_cast<uintptr_t>(segment) % SimpleAllocatorTraits::ALIGNMENT) {
+    return false;
+  }
+
+  auto *header = static_cast<SegmentHeader *>(segment);
+  if (header->magic != SEGMENT_MAGIC) {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  header_ = header;
+  return true;
+}
+
+uint64_t SharedSimpleAllocator::ToOffset(const void *ptr) const noexcept {
+  return ptr ? static_cast<uint64_t>(static_cast<const uint8_t *>(ptr) - reinterpret_cast<const uint8_t *>(header_)) : 0;
+}
+
+void *SharedSimpleAllocator::FromOffset(uint64_t offset) const noexcept {
+  return offset ? AtOffset(offset) : nullptr;
+}
+
+uint8_t *SharedSimpleAllocator::AtOffset(uint64_t offset) const noexcept {
+  return reinterpret_cast<uint8_t *>(header_) + offset;
+}
+
+uint64_t SharedSimpleAllocator::PopFreeBlock(uint64_t &list_head) noexcept {
+  const uint64_t block_offset = list_head;
+  if (block_offset) {
+    auto *memory_block = reinterpret_cast<MemoryBlock *>(AtOffset(block_offset));
+    std::memcpy(&list_head, memory_block->UserMemoryBegin(), sizeof(list_head));
+  }
+  return block_offset;
+}
+
+void SharedSimpleAllocator::PushFreeBlock(uint64_t &list_head, MemoryBlock *memory_block) noexcept {
+  std::memcpy(memory_block->UserMemoryBegin(), &list_head, sizeof(list_head));
+  list_head = ToOffset(memory_block);
+}
+
+size_t SharedSimpleAllocator::GetLargeBinIndex(size_t size) noexcept {
+  size_t bin = 0;
+  for (size = size / MAX_SLOT_SIZE_; size > 1 && bin + 1 < LARGE_BINS; size >>= 1) {
+    ++bin;
+  }
+  return bin;
+}
+
+MemoryBlock *SharedSimpleAllocator::RetrieveLargeBlock(size_t size) noexcept {
+  const size_t first_bin = GetLargeBinIndex(size);
+  uint64_t *link = &header_->large_bins[first_bin];
+  while (*link) {
+    auto *memory_block = reinterpret_cast<MemoryBlock *>(AtOffset(*link));
+    if (memory_block->GetBlockSize() >= size) {
+      PopFreeBlock(*link);
+      return memory_block;
+    }
+    link = reinterpret_cast<uint64_t *>(memory_block->UserMemoryBegin());
+  }
+
+  for (size_t bin = first_bin + 1; bin < LARGE_BINS; ++bin) {
+    if (const uint64_t block_offset = PopFreeBlock(header_->large_bins[bin])) {
+      return reinterpret_cast<MemoryBlock *>(AtOffset(block_offset));
+    }
+  }
+  return nullptr;
+}
+
+void SharedSimpleAllocator::InsertLargeBlock(MemoryBlock *memory_block) noexcept {
+  PushFreeBlock(header_->large_bins[GetLargeBinIndex(memory_block->GetBlockSize())], memory_block);
+}
+
+void *SharedSimpleAllocator::Allocate(size_t size) noexcept {
+  // Larger than the segment, the size would wrap around when aligned near SIZE_MAX
+  if (!size || !header_ || size > header_->end) {
+    return nullptr;
+  }
+
+  size = AlignN<SimpleAllocatorTraits::ALIGNMENT>(size);
+
+  ScopedLock lock{header_->lock};
+  const size_t slot_index = GetSlotIndex(size);
+  if (slot_index < header_->slots.size()) {
+    size = GetSlotSize(slot_index);
+    if (const uint64_t block_offset = PopFreeBlock(header_->slots[slot_index])) {
+      return reinterpret_cast<MemoryBlock *>(AtOffset(block_offset))->UserMemoryBegin();
+    }
+  } else if (MemoryBlock *memory_block = RetrieveLargeBlock(size)) {
+    const size_t total_left_size = memory_block->GetBlockSize() - size;
+    if (total_left_size > sizeof(MemoryBlock)) {
+      const size_t user_left_size = total_left_size - sizeof(MemoryBlock);
+      if (GetSlotIndex(user_left_size) >= header_->slots.size()) {
+        memory_block->SetBlockSize(size);
+        InsertLargeBlock(new (memory_block->UserMemoryEnd()) MemoryBlock{user_left_size});
+      }
+    }
+    return memory_block->UserMemoryBegin();
+  }
+
+  if (header_->current + sizeof(MemoryBlock) + size > header_->end) {
+    return nullptr;
+  }
+  auto *memory_block = new (AtOffset(header_->current)) MemoryBlock{size};
+  header_->current += sizeof(MemoryBlock) + size;
+  return memory_block->UserMemoryBegin();
+}
+
+void SharedSimpleAllocator::Deallocate(void *ptr) noexcept {
+  if (!ptr || !header_) {
+    return;
+  }
+
+  auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+  ScopedLock lock{header_->lock};
+  if (ToOffset(memory_block->UserMemoryEnd()) == header_->current) {
+    header_->current = ToOffset(memory_block);
+    return;
+  }
+
+  const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize());
+  if (slot_index < header_->slots.size()) {
+    PushFreeBlock(header_->slots[slot_index], memory_block);
+  } else {
+    InsertLargeBlock(memory_block);
+  }
+}
+
+size_t SharedSimpleAllocator::Size(void *ptr) noexcept {
+  return ptr ? MemoryBlock::FromUserMemory(ptr)->GetBlockSize() : 0;
+}
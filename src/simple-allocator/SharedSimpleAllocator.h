@@ -0,0 +1,44 @@
+// Simple Allocator 2024
+#ifndef SHAREDSIMPLEALLOCATOR_H
+#define SHAREDSIMPLEALLOCATOR_H
+#include "SimpleAllocator.h"
+
+#include <cstdint>
+
+// SimpleAllocator variant which keeps all of its state inside the managed buffer, so the buffer can be
+// a shared memory segment mapped by several processes at different addresses. Free lists are linked by
+// offsets from the segment begin and every operation is serialized by a lock living in the segment.
+// A block allocated by one process may be deallocated by any other attached process. On Linux the lock is a robust mutex,
+// so a process which dies holding it leaves it to the next waiter; elsewhere it is a spin lock which stays held.
+class SharedSimpleAllocator : SimpleAllocatorBase {
+public:
+  SharedSimpleAllocator() = default;
+
+  // Formats the segment, must be called once by the process which created it.
+  bool Create(void *segment, size_t segment_size) noexcept;
+  // Attaches to a segment which was formatted by Create, possibly in another process.
+  bool Attach(void *segment) noexcept;
+
+  void *Allocate(size_t size) noexcept;
+  void Deallocate(void *ptr) noexcept;
+  static size_t Size(void *ptr) noexcept;
+
+  // Offsets are the same in every process, pointers are not.
+  uint64_t ToOffset(const void *ptr) const noexcept;
+  void *FromOffset(uint64_t offset) const noexcept;
+
+private:
+  struct SegmentHeader;
+  class ScopedLock;
+
+  uint8_t *AtOffset(uint64_t offset) const noexcept;
+  uint64_t PopFreeBlock(uint64_t &list_head) noexcept;
+  void PushFreeBlock(uint64_t &list_head, MemoryBlock *memory_block) noexcept;
+  MemoryBlock *RetrieveLargeBlock(size_t size) noexcept;
+  void InsertLargeBlock(MemoryBlock *memory_block) noexcept;
+  static size_t GetLargeBinIndex(size_t size) noexcept;
+
+  SegmentHeader *header_{nullptr};
+};
+
+#endif // SHAREDSIMPLEALLOCATOR_H
@@ -1,23 +1,35 @@
 // Simple Allocator 2024
 #include "SimpleAllocator.h"
 
+#include "CycleCounter.h"
 #include "MemoryBlock.h"
 #include "SimpleAllocatorTraits.h"
+#include "StreamingCopy.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace {
 
-template<size_t N, class T>
-constexpr T AlignN(T v) noexcept {
-  static_assert(N && ((N - 1) & N) == 0, "power of 2 is expected");
-  return static_cast<T>((static_cast<uint64_t>(v) + N - 1) & (~(N - 1)));
-}
-
-template<size_t N, class T>
-constexpr std::pair<T *, T *> AlignBuffer(T *begin, T *end) noexcept {
-  return {reinterpret_cast<T *>(AlignN<N>(reinterpret_cast<uintptr_t>(begin))), reinterpret_cast<T *>(AlignN<N>(reinterpret_cast<uintptr_t>(end) - (N - 1)))};
+// MADV_POPULATE_WRITE faults a range in with one call where it exists (Linux 5.14+), otherwise every page is written once.
+// The writes keep the bytes as they are, the range may hold carved blocks already.
+void PrefaultPages(uint8_t *begin, size_t size) noexcept {
+  if (!size) {
+    return;
+  }
+  const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#ifdef MADV_POPULATE_WRITE
+  const uintptr_t page_begin = reinterpret_cast<uintptr_t>(begin) & ~(page_size - 1);
+  if (madvise(reinterpret_cast<void *>(page_begin), reinterpret_cast<uintptr_t>(begin) + size - page_begin, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+#endif
+  for (auto *page = reinterpret_cast<volatile uint8_t *>(begin); page < begin + size; page += page_size) {
+    *page = *page;
+  }
 }
 
 } // namespace
@@ -34,6 +46,18 @@ bool SimpleAllocator::Init(void *buffer, size_t buffer_size) noexcept {
     return false;
   }
 
+#ifdef SIMPLE_ALLOCATOR_COMPACT_INDEX
+  // The index takes the end of the buffer, away from the blocks
+  const size_t index_size = AlignN<SimpleAllocatorTraits::ALIGNMENT>(CompactBlockIndex::RequiredSize(static_cast<size_t>(buffer_end - buffer_begin)));
+  if (index_size >= static_cast<size_t>(buffer_end - buffer_begin)) {
+    return false;
+  }
+  buffer_end -= index_size;
+  if (!large_blocks_.Init(buffer_end, index_size, static_cast<size_t>(buffer_end - buffer_begin))) {
+    return false;
+  }
+#endif
+
   buffer_begin_ = buffer_begin;
   buffer_end_ = buffer_end;
   current_ = buffer_begin_;
@@ -41,7 +65,7 @@ bool SimpleAllocator::Init(void *buffer, size_t buffer_size) noexcept {
 }
 
 uint8_t *SimpleAllocator::CutBuffer(size_t size) noexcept {
-  if (current_ + size > buffer_end_) {
+  if (size > static_cast<size_t>(buffer_end_ - current_)) {
     return nullptr;
   }
 
@@ -50,8 +74,56 @@ uint8_t *SimpleAllocator::CutBuffer(size_t size) noexcept {
   return memory_piece;
 }
 
-void *SimpleAllocator::Allocate(size_t size) noexcept {
-  if (!size) {
+// A cursor at or over the new bump pointer may end up inside a block cut from the buffer next, so the pass starts over
+[[gnu::always_inline]] inline void SimpleAllocator::RollBackCurrent(uint8_t *current) noexcept {
+  current_ = current;
+  if (compact_cursor_ >= current_) [[unlikely]] {
+    compact_cursor_ = nullptr;
+  }
+}
+
+// A near fit from the unsorted bin as it is, otherwise the bin is sorted and the best fit from the index is split:
+// a large rest goes back to the index, a smaller one above the split threshold to the slot of the largest class it holds
+[[gnu::always_inline]] inline MemoryBlock *SimpleAllocator::RetrieveLargeBlock(size_t size, AllocationPath &path) noexcept {
+  if (!unsorted_bin_.IsEmpty()) {
+    if (MemoryBlock *memory_block = unsorted_bin_.RetrieveBlock(size)) {
+      path = AllocationPath::BIN_HIT;
+      return memory_block;
+    }
+    unsorted_bin_.SortInto(large_blocks_);
+  }
+
+  MemoryBlock *memory_block = large_blocks_.RetrieveBlock(size);
+  if (!memory_block) {
+    path = AllocationPath::TREE_MISS;
+    return nullptr;
+  }
+  path = AllocationPath::TREE_HIT;
+  const size_t total_left_size = memory_block->GetBlockSize() - size;
+  if (total_left_size > sizeof(MemoryBlock)) {
+    const size_t user_left_size = total_left_size - sizeof(MemoryBlock);
+    const size_t slot_index = GetSlotIndex(user_left_size);
+    if (slot_index >= slots_.size()) {
+      memory_block->SetBlockSize(size);
+      auto left_memory_block = new (memory_block->UserMemoryEnd()) MemoryBlock{user_left_size};
+      large_blocks_.InsertBlock(left_memory_block);
+      path = AllocationPath::TREE_HIT_SPLIT;
+    } else if (const size_t left_slot_index = GetSlotSize(slot_index) == user_left_size ? slot_index : slot_index - 1;
+               user_left_size >= slot_split_threshold_ && left_slot_index < slots_.size()) {
+      // Between two size classes the rest makes a block of the smaller one, the bytes over it stay with the allocation
+      const size_t left_size = GetSlotSize(left_slot_index);
+      memory_block->SetBlockSize(memory_block->GetBlockSize() - sizeof(MemoryBlock) - left_size);
+      slots_[left_slot_index].AddNext(new (memory_block->UserMemoryEnd()) MemoryBlock{left_size});
+      path = AllocationPath::TREE_HIT_SPLIT;
+    }
+  }
+  return memory_block;
+}
+
+[[gnu::always_inline]] inline void *SimpleAllocator::AllocateImpl(size_t size, AllocationPath &path) noexcept {
+  path = AllocationPath::SLOT_MISS;
+  // Larger than the buffer, the size would wrap around when aligned near SIZE_MAX
+  if (!size || size > static_cast<size_t>(buffer_end_ - buffer_begin_)) {
     return nullptr;
   }
 
@@ -59,19 +131,12 @@ void *SimpleAllocator::Allocate(size_t size) noexcept {
 
   const size_t slot_index = GetSlotIndex(size);
   if (slot_index < slots_.size()) {
+    size = GetSlotSize(slot_index);
     if (MemoryBlock *memory_block = slots_[slot_index].GetNext()) {
+      path = AllocationPath::SLOT_HIT;
       return memory_block->UserMemoryBegin();
     }
-  } else if (MemoryBlock *memory_block = memory_tree_.RetrieveBlock(size)) {
-    const size_t total_left_size = memory_block->GetBlockSize() - size;
-    if (total_left_size > sizeof(MemoryBlock)) {
-      const size_t user_left_size = total_left_size - sizeof(MemoryBlock);
-      if (GetSlotIndex(user_left_size) >= slots_.size()) {
-        memory_block->SetBlockSize(size);
-        auto left_memory_block = new (memory_block->UserMemoryEnd()) MemoryBlock{user_left_size};
-        memory_tree_.InsertBlock(left_memory_block);
-      }
-    }
+  } else if (MemoryBlock *memory_block = RetrieveLargeBlock(size, path)) {
     return memory_block->UserMemoryBegin();
   }
 
@@ -80,29 +145,67 @@ void *SimpleAllocator::Allocate(size_t size) noexcept {
     auto *memory_block = new (memory_piece) MemoryBlock{size};
     return memory_block->UserMemoryBegin();
   }
+  if (!deferred_blocks_.IsEmpty()) {
+    return AllocateWithDeferred(size, path);
+  }
   return nullptr;
 }
 
-void *SimpleAllocator::Reallocate(void *ptr, size_t new_size) noexcept {
+[[gnu::always_inline]] inline void SimpleAllocator::DeallocateImpl(void *ptr) noexcept {
+  if (!ptr) {
+    return;
+  }
+
+  auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+  if (memory_block->UserMemoryEnd() == current_) {
+    RollBackCurrent(reinterpret_cast<uint8_t *>(memory_block));
+    return;
+  }
+
+  memory_block->SetGrowthMoves(0);
+  const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize());
+  if (slot_index < slots_.size()) {
+    slots_[slot_index].AddNext(memory_block);
+  } else if (defer_free_) {
+    deferred_blocks_.AddNext(memory_block);
+  } else if (!unsorted_bin_.IsFull()) {
+    unsorted_bin_.AddBlock(memory_block);
+  } else {
+    OverflowUnsortedBin(memory_block);
+  }
+}
+
+[[gnu::always_inline]] inline void *SimpleAllocator::ReallocateImpl(void *ptr, size_t new_size, AllocationPath &path) noexcept {
   if (!ptr) {
-    return Allocate(new_size);
+    return AllocateImpl(new_size, path);
   }
 
   if (!new_size) {
-    Deallocate(ptr);
+    path = AllocationPath::DEALLOCATE;
+    DeallocateImpl(ptr);
     return nullptr;
   }
 
-  new_size = AlignN<SimpleAllocatorTraits::ALIGNMENT>(new_size);
+  path = AllocationPath::REALLOCATE_IN_PLACE;
+  if (new_size > static_cast<size_t>(buffer_end_ - buffer_begin_)) {
+    return nullptr;
+  }
+
+  new_size = GetBlockSize(AlignN<SimpleAllocatorTraits::ALIGNMENT>(new_size));
 
   auto *memory_block = MemoryBlock::FromUserMemory(ptr);
   if (new_size == memory_block->GetBlockSize()) {
     return ptr;
   }
 
+  // A block moved to grow before keeps its headroom, even at the end of the heap, while it stays over half of it
+  if (memory_block->GetGrowthMoves() && new_size < memory_block->GetBlockSize() && new_size > memory_block->GetBlockSize() / 2) {
+    return ptr;
+  }
+
   if (memory_block->UserMemoryEnd() == current_) {
     if (new_size < memory_block->GetBlockSize()) {
-      current_ -= memory_block->GetBlockSize() - new_size;
+      RollBackCurrent(current_ - (memory_block->GetBlockSize() - new_size));
       memory_block->SetBlockSize(new_size);
       return ptr;
     }
@@ -113,33 +216,306 @@ void *SimpleAllocator::Reallocate(void *ptr, size_t new_size) noexcept {
     }
   }
 
-  auto *new_ptr = Allocate(new_size);
+  // A block which keeps growing takes headroom for its next growth, if the buffer still has room for it
+  const size_t growth_moves = new_size > memory_block->GetBlockSize() ? memory_block->GetGrowthMoves() + 1 : 0;
+  AllocationPath allocate_path;
+  void *new_ptr = nullptr;
+  if (growth_moves > SimpleAllocatorTraits::GROWTH_MOVES_WITHOUT_HEADROOM && new_size <= SIZE_MAX / 4) {
+    new_ptr = AllocateImpl(GetBlockSize(2 * new_size), allocate_path);
+  }
+  if (!new_ptr) {
+    new_ptr = AllocateImpl(new_size, allocate_path);
+  }
   if (new_ptr) {
-    std::memcpy(new_ptr, ptr, std::min(memory_block->GetBlockSize(), new_size));
-    Deallocate(ptr);
+    MemoryBlock::FromUserMemory(new_ptr)->SetGrowthMoves(growth_moves);
+    const size_t copy_size = std::min(memory_block->GetBlockSize(), new_size);
+    if (copy_size >= streaming_copy_threshold_) {
+      StreamingCopy(new_ptr, ptr, copy_size);
+    } else {
+      std::memcpy(new_ptr, ptr, copy_size);
+    }
+    DeallocateImpl(ptr);
   }
+  path = AllocationPath::REALLOCATE_MOVE;
   return new_ptr;
 }
 
-void SimpleAllocator::Deallocate(void *ptr) noexcept {
-  if (!ptr) {
-    return;
+void *SimpleAllocator::AllocateSlow(size_t size) noexcept {
+  AllocationPath path;
+  return AllocateImpl(size, path);
+}
+
+void SimpleAllocator::DeallocateSlow(void *ptr) noexcept {
+  DeallocateImpl(ptr);
+}
+
+// Out of line, so the free paths which don't sort stay without a stack frame
+void SimpleAllocator::OverflowUnsortedBin(MemoryBlock *memory_block) noexcept {
+  unsorted_bin_.SortInto(large_blocks_);
+  unsorted_bin_.AddBlock(memory_block);
+}
+
+// The deferred blocks are the last resort before the buffer runs out
+void *SimpleAllocator::AllocateWithDeferred(size_t size, AllocationPath &path) noexcept {
+  FlushDeferred();
+  return AllocateImpl(size, path);
+}
+
+bool SimpleAllocator::Warmup(const WarmupProfile &profile) noexcept {
+  uint8_t *prefault_begin = current_;
+  bool carved = true;
+  for (const auto &[size, count] : profile.slot_blocks) {
+    const size_t slot_index = GetRequestSlotIndex(size);
+    if (!size || slot_index >= slots_.size()) {
+      carved = false;
+      break;
+    }
+    // Pushed from the last one, so the slot hands the blocks out in the order of addresses
+    const size_t block_size = sizeof(MemoryBlock) + GetSlotSize(slot_index);
+    const size_t carved_count = std::min(count, static_cast<size_t>(buffer_end_ - current_) / block_size);
+    uint8_t *blocks = CutBuffer(carved_count * block_size);
+    for (size_t i = carved_count; i != 0; --i) {
+      slots_[slot_index].AddNext(new (blocks + (i - 1) * block_size) MemoryBlock{GetSlotSize(slot_index)});
+    }
+    if (carved_count != count) {
+      carved = false;
+      break;
+    }
   }
 
-  auto *memory_block = MemoryBlock::FromUserMemory(ptr);
-  if (memory_block->UserMemoryEnd() == current_) {
-    current_ = reinterpret_cast<uint8_t *>(memory_block);
-    return;
+  const size_t prefault_size = std::min(profile.prefault_size, static_cast<size_t>(buffer_end_ - prefault_begin));
+  PrefaultPages(prefault_begin, prefault_size);
+  return carved;
+}
+
+void SimpleAllocator::SetDeferredFree(bool deferred) noexcept {
+  defer_free_ = deferred;
+  if (!deferred) {
+    FlushDeferred();
   }
+}
 
-  const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize());
-  if (slot_index < slots_.size()) {
-    slots_[slot_index].AddNext(memory_block);
+void SimpleAllocator::FlushDeferred() noexcept {
+  while (MemoryBlock *memory_block = deferred_blocks_.GetNext()) {
+    large_blocks_.InsertBlock(memory_block);
+  }
+}
+
+// Two walks over the window: the first decides where the step stops and unlinks its free blocks while their links are intact,
+// the second moves the blocks.
+size_t SimpleAllocator::Compact(size_t budget, const BlockRelocator &relocator) noexcept {
+  using BlockUse = BlockRelocator::BlockUse;
+  uint8_t *const window_begin = compact_cursor_ ? compact_cursor_ : buffer_begin_;
+
+  std::array<bool, SizeClasses::COUNT> slots_touched{};
+  bool large_touched = false;
+  uint8_t *window_end = window_begin;
+  uint8_t *dest = window_begin;
+  for (size_t cost = 0; window_end != current_ && cost < budget;) {
+    auto *memory_block = reinterpret_cast<MemoryBlock *>(window_end);
+    uint8_t *next = memory_block->UserMemoryEnd();
+    switch (relocator.classify(memory_block->UserMemoryBegin(), relocator.context)) {
+    case BlockUse::UNUSED:
+      if (const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize()); slot_index < slots_.size()) {
+        slots_touched[slot_index] = true;
+      } else {
+        large_blocks_.RemoveBlock(memory_block);
+        large_touched = true;
+      }
+      break;
+    case BlockUse::PINNED:
+      dest = next;
+      break;
+    case BlockUse::MOVABLE:
+      cost += dest != window_end ? static_cast<size_t>(next - window_end) : 0;
+      dest += next - window_end;
+      break;
+    }
+    cost += sizeof(MemoryBlock);
+    window_end = next;
+  }
+  UnlistFreeBlocks(window_begin, window_end, slots_touched, large_touched);
+
+  size_t moved = 0;
+  dest = window_begin;
+  for (uint8_t *block = window_begin; block != window_end;) {
+    auto *memory_block = reinterpret_cast<MemoryBlock *>(block);
+    uint8_t *next = memory_block->UserMemoryEnd();
+    switch (relocator.classify(memory_block->UserMemoryBegin(), relocator.context)) {
+    case BlockUse::UNUSED:
+      break;
+    case BlockUse::PINNED:
+      ReleaseGap(dest, block);
+      dest = next;
+      break;
+    case BlockUse::MOVABLE:
+      if (dest != block) {
+        std::memmove(dest, block, static_cast<size_t>(next - block));
+        relocator.moved(memory_block->UserMemoryBegin(), reinterpret_cast<MemoryBlock *>(dest)->UserMemoryBegin(), relocator.context);
+        moved += static_cast<size_t>(next - block);
+      }
+      dest += next - block;
+      break;
+    }
+    block = next;
+  }
+
+  if (window_end == current_) {
+    current_ = dest;
+    compact_cursor_ = nullptr;
   } else {
-    memory_tree_.InsertBlock(memory_block);
+    // The next step starts with the gap as an unused block
+    ReleaseGap(dest, window_end);
+    compact_cursor_ = dest;
+  }
+  return moved;
+}
+
+// The lists have no links back, the touched ones are filtered. The blocks of the index were taken out one by one already.
+void SimpleAllocator::UnlistFreeBlocks(const uint8_t *begin, const uint8_t *end, std::span<const bool> slots_touched, bool large_touched) noexcept {
+  const auto in_window = [begin, end](const void *memory) noexcept {
+    return memory >= begin && memory < end;
+  };
+  for (size_t slot_index = 0; slot_index != slots_.size(); ++slot_index) {
+    if (slots_touched[slot_index]) {
+      slots_[slot_index].RemoveIf(in_window);
+    }
+  }
+  if (large_touched) {
+    unsorted_bin_.RemoveIf(in_window);
+    deferred_blocks_.RemoveIf(in_window);
+  }
+}
+
+// The space between two blocks becomes a free block. Without a slot of its size it stays allocated, the next pass takes it back.
+void SimpleAllocator::ReleaseGap(uint8_t *begin, uint8_t *end) noexcept {
+  if (begin == end) {
+    return;
+  }
+  const size_t size = static_cast<size_t>(end - begin) - sizeof(MemoryBlock);
+  auto *memory_block = new (begin) MemoryBlock{size};
+  if (GetBlockSize(size) == size) {
+    DeallocateImpl(memory_block->UserMemoryBegin());
   }
 }
 
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+void *SimpleAllocator::AllocateSampled(size_t size) noexcept {
+  AllocationPath path;
+  const uint64_t start = ReadCycleCounter();
+  void *ptr = AllocateImpl(size, path);
+  latency_histograms_.Record(path, ReadCycleCounter() - start);
+  return ptr;
+}
+
+void SimpleAllocator::DeallocateSampled(void *ptr) noexcept {
+  const uint64_t start = ReadCycleCounter();
+  DeallocateImpl(ptr);
+  latency_histograms_.Record(AllocationPath::DEALLOCATE, ReadCycleCounter() - start);
+}
+#endif
+
+AllocationResult SimpleAllocator::AllocateAtLeast(size_t size) noexcept {
+  void *ptr = Allocate(size);
+  return {ptr, Size(ptr)};
+}
+
+void *SimpleAllocator::Reallocate(void *ptr, size_t new_size) noexcept {
+  AllocationPath path;
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+  if (latency_histograms_.ShouldSample()) [[unlikely]] {
+    const uint64_t start = ReadCycleCounter();
+    void *new_ptr = ReallocateImpl(ptr, new_size, path);
+    latency_histograms_.Record(path, ReadCycleCounter() - start);
+    return new_ptr;
+  }
+#endif
+  return ReallocateImpl(ptr, new_size, path);
+}
+
 size_t SimpleAllocator::Size(void *ptr) noexcept {
   return ptr ? MemoryBlock::FromUserMemory(ptr)->GetBlockSize() : 0;
 }
+
+// Marks the free blocks of the tree, the unsorted bin, the deferred ones and then the slots, stopping at the first one which is not
+// a block of its size in the heap, or is marked already: a cycle or a block listed twice. Clearing walks in the same order and stops
+// at the first unmarked block, which undoes exactly what marking did. A mark can't land in the links of a tree node, their words
+// never look like a slot size.
+bool SimpleAllocator::SetFreeBlockMarks(bool marked, size_t &count) noexcept {
+  struct Context {
+    SimpleAllocator *allocator;
+    size_t slot_index;
+    bool marked;
+    size_t &count;
+
+    bool Visit(void *memory) noexcept {
+      auto *address = static_cast<uint8_t *>(memory);
+      if (address < allocator->buffer_begin_ + sizeof(MemoryBlock) || address > allocator->current_ ||
+          reinterpret_cast<uintptr_t>(address) % SimpleAllocatorTraits::ALIGNMENT) {
+        return false;
+      }
+      auto *memory_block = MemoryBlock::FromUserMemory(memory);
+      if (memory_block->IsMarked() == marked) {
+        return false;
+      }
+      const size_t size = memory_block->GetUnmarkedBlockSize();
+      if (marked && (!size || std::min(GetSlotIndex(size), allocator->slots_.size()) != slot_index ||
+                     size > static_cast<size_t>(allocator->current_ - address))) {
+        return false;
+      }
+      memory_block->SetMarked(marked);
+      count += marked ? 1 : 0;
+      return true;
+    }
+  } context{this, slots_.size(), marked, count};
+
+  const auto visit_tree_block = [](MemoryBlock *memory_block, void *tree_context) noexcept {
+    return static_cast<Context *>(tree_context)->Visit(memory_block->UserMemoryBegin());
+  };
+  if (!large_blocks_.ForEachBlock(visit_tree_block, &context) ||
+      !unsorted_bin_.ForEach([&context](MemoryBlock *memory_block, size_t) noexcept { return context.Visit(memory_block->UserMemoryBegin()); }) ||
+      !deferred_blocks_.ForEach([&context](void *memory) noexcept { return context.Visit(memory); })) {
+    return false;
+  }
+  for (context.slot_index = 0; context.slot_index != slots_.size(); ++context.slot_index) {
+    if (!slots_[context.slot_index].ForEach([&context](void *memory) noexcept { return context.Visit(memory); })) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SimpleAllocator::Validate() noexcept {
+  size_t blocks = 0;
+  for (uint8_t *block = buffer_begin_; block != current_; ++blocks) {
+    auto *memory_block = reinterpret_cast<MemoryBlock *>(block);
+    const size_t size = memory_block->GetBlockSize();
+    if (!size || size % SimpleAllocatorTraits::ALIGNMENT || size > static_cast<size_t>(current_ - memory_block->UserMemoryBegin())) {
+      return false;
+    }
+    block = memory_block->UserMemoryEnd();
+  }
+  // The tree is walked by the marking, so its links are checked first
+  if (!large_blocks_.Validate(buffer_begin_, current_, blocks)) {
+    return false;
+  }
+
+  size_t marked_blocks = 0;
+  bool valid = SetFreeBlockMarks(true, marked_blocks);
+  if (valid) {
+    // A mark in the middle of a block is not found by the walk
+    size_t found_marks = 0;
+    for (uint8_t *block = buffer_begin_; block != current_;) {
+      auto *memory_block = reinterpret_cast<MemoryBlock *>(block);
+      found_marks += memory_block->IsMarked() ? 1 : 0;
+      block = memory_block->UserMemoryBegin() + memory_block->GetUnmarkedBlockSize();
+    }
+    // The bin keeps the sizes of its blocks apart from the headers
+    valid = found_marks == marked_blocks && unsorted_bin_.ForEach([](MemoryBlock *memory_block, size_t size) noexcept {
+              return memory_block->GetUnmarkedBlockSize() == size;
+            });
+  }
+  size_t cleared_blocks = 0;
+  SetFreeBlockMarks(false, cleared_blocks);
+  return valid;
+}
@@ -1,11 +1,19 @@
 // Simple Allocator 2024
 #ifndef SIMPLEALLOCATOR_H
 #define SIMPLEALLOCATOR_H
+#include "CompactBlockIndex.h"
+#include "LatencyHistogram.h"
+#include "MemoryBlock.h"
 #include "MemorySlot.h"
 #include "MemoryTree.h"
+#include "SizeClasses.h"
+#include "UnsortedBin.h"
 
 #include <array>
 #include <cstdint>
+#include <new>
+#include <span>
+#include <utility>
 
 class SimpleAllocatorBase {
 private:
@@ -14,10 +22,81 @@ private:
   }
 
 protected:
+  // Slot of an aligned size, SizeClasses::COUNT or more if the size is for the tree
   static constexpr size_t GetSlotIndex(size_t size) noexcept {
     constexpr size_t alignment_shift = ConstExprLog2(SimpleAllocatorTraits::ALIGNMENT);
-    return (size >> alignment_shift) - 1;
+    if constexpr (SizeClasses::IS_LINEAR) {
+      return (size >> alignment_shift) - 1;
+    } else {
+      return size < MAX_SLOT_SIZE_ ? SizeClasses::INDICES[size >> alignment_shift] : SizeClasses::COUNT;
+    }
   }
+
+  // Slot of a requested size, which may wrap around to 0 when aligned near SIZE_MAX: such a size is for the tree
+  static constexpr size_t GetRequestSlotIndex(size_t size) noexcept {
+    if constexpr (SizeClasses::IS_LINEAR) {
+      return GetSlotIndex(AlignN<SimpleAllocatorTraits::ALIGNMENT>(size));
+    } else {
+      return size <= MAX_SLOT_SIZE_ - SimpleAllocatorTraits::ALIGNMENT ? GetSlotIndex(AlignN<SimpleAllocatorTraits::ALIGNMENT>(size)) : SizeClasses::COUNT;
+    }
+  }
+
+  static constexpr size_t GetSlotSize(size_t slot_index) noexcept {
+    if constexpr (SizeClasses::IS_LINEAR) {
+      return (slot_index + 1) * SimpleAllocatorTraits::ALIGNMENT;
+    } else {
+      return SizeClasses::SIZES[slot_index];
+    }
+  }
+
+  // Block size for an aligned size: the size of its class, or the size itself for the tree
+  static constexpr size_t GetBlockSize(size_t size) noexcept {
+    const size_t slot_index = GetSlotIndex(size);
+    return slot_index < SizeClasses::COUNT ? GetSlotSize(slot_index) : size;
+  }
+
+  template<size_t N, class T>
+  static constexpr T AlignN(T v) noexcept {
+    static_assert(N && ((N - 1) & N) == 0, "power of 2 is expected");
+    return static_cast<T>((static_cast<uint64_t>(v) + N - 1) & (~(N - 1)));
+  }
+
+  template<size_t N, class T>
+  static constexpr std::pair<T *, T *> AlignBuffer(T *begin, T *end) noexcept {
+    return {reinterpret_cast<T *>(AlignN<N>(reinterpret_cast<uintptr_t>(begin))), reinterpret_cast<T *>(AlignN<N>(reinterpret_cast<uintptr_t>(end) - (N - 1)))};
+  }
+
+  constexpr static size_t MAX_SLOT_SIZE_{SimpleAllocatorTraits::MAX_SLOT_SIZE};
+};
+
+// Memory and its usable size, which may exceed the requested one
+struct AllocationResult {
+  void *ptr;
+  size_t size;
+};
+
+// What SimpleAllocator::Warmup prepares before the first request
+struct WarmupProfile {
+  // Blocks carved into the slot of a size up front
+  struct SlotBlocks {
+    size_t size;
+    size_t count;
+  };
+
+  // Bytes from the bump pointer to fault in, including the carved blocks
+  size_t prefault_size{0};
+  std::span<const SlotBlocks> slot_blocks;
+};
+
+// What SimpleAllocator::Compact asks the owner of the blocks, the callbacks must not call the allocator
+struct BlockRelocator {
+  enum class BlockUse { UNUSED, MOVABLE, PINNED };
+
+  // UNUSED is for free blocks and allocated ones nobody references any more, which the compaction takes back
+  BlockUse (*classify)(void *ptr, void *context);
+  // The memory of a MOVABLE block was moved, references to it must follow
+  void (*moved)(void *from, void *to, void *context);
+  void *context;
 };
 
 class SimpleAllocator : SimpleAllocatorBase {
@@ -25,22 +104,172 @@ public:
   SimpleAllocator() = default;
   bool Init(void *buffer, size_t buffer_size) noexcept;
 
-  void *Allocate(size_t size) noexcept;
-  void Deallocate(void *ptr) noexcept;
-  void *Reallocate(void *ptr, size_t new_size) noexcept;
+  // A slot hit or a cut from the buffer is inlined into the caller, the tree and all the rest goes to AllocateSlow
+  [[gnu::malloc]] [[gnu::alloc_size(2)]] void *Allocate(size_t size) noexcept {
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+    if (latency_histograms_.ShouldSample()) [[unlikely]] {
+      return AllocateSampled(size);
+    }
+#endif
+    const size_t slot_index = GetRequestSlotIndex(size);
+    if (size && slot_index < slots_.size()) [[likely]] {
+      if (void *memory = slots_[slot_index].Pop()) {
+        return memory;
+      }
+      const size_t block_size = GetSlotSize(slot_index);
+      if (current_ + sizeof(MemoryBlock) + block_size <= buffer_end_) [[likely]] {
+        auto *memory_block = new (current_) MemoryBlock{block_size};
+        current_ = memory_block->UserMemoryEnd();
+        return memory_block->UserMemoryBegin();
+      }
+    }
+    return AllocateSlow(size);
+  }
+
+  // Same as Allocate, but hands out the whole block: the size rounded up to its size class, plus what a near fit
+  // from the unsorted bin has over the size, or the rest of a tree block which was not split off.
+  AllocationResult AllocateAtLeast(size_t size) noexcept;
+
+  // Only a block going back to its slot is inlined
+  void Deallocate(void *ptr) noexcept {
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+    if (latency_histograms_.ShouldSample()) [[unlikely]] {
+      return DeallocateSampled(ptr);
+    }
+#endif
+    if (!ptr) {
+      return;
+    }
+    // The header is in front of the memory which alloc_size told the compiler about
+    asm("" : "+r"(ptr));
+    auto *memory_block = MemoryBlock::FromUserMemory(ptr);
+    const size_t slot_index = GetSlotIndex(memory_block->GetBlockSize());
+    if (slot_index < slots_.size() && memory_block->UserMemoryEnd() != current_) [[likely]] {
+      memory_block->SetGrowthMoves(0);
+      slots_[slot_index].AddNext(memory_block);
+      return;
+    }
+    DeallocateSlow(ptr);
+  }
+
+  [[gnu::alloc_size(3)]] void *Reallocate(void *ptr, size_t new_size) noexcept;
   static size_t Size(void *ptr) noexcept;
 
+  // While deferring, a freed block over the slot sizes skips the tree and waits in a list threaded through the blocks,
+  // so a free on a latency-critical path is a push. The blocks are inserted in a batch by FlushDeferred at a quiet point,
+  // or when the buffer runs out. Disabling flushes. Like everything else here, the calls need the allocator's own thread or lock.
+  void SetDeferredFree(bool deferred) noexcept;
+  void FlushDeferred() noexcept;
+
+  // Takes the page faults and slot misses of the first requests up front: carves the blocks of the profile into their slots,
+  // then faults in the buffer from where the bump pointer was. False if a size is not for a slot or the buffer runs out,
+  // whatever was carved before stays in the slots.
+  bool Warmup(const WarmupProfile &profile) noexcept;
+
+  // Reallocate moves of at least this many bytes use StreamingCopy, SIZE_MAX keeps std::memcpy for all of them
+  void SetStreamingCopyThreshold(size_t threshold) noexcept {
+    streaming_copy_threshold_ = threshold;
+  }
+
+  // The rest of a split tree block under the slot sizes goes to the slot of the largest class it holds from this many bytes on,
+  // SIZE_MAX leaves every such rest with the allocation
+  void SetSlotSplitThreshold(size_t threshold) noexcept {
+    slot_split_threshold_ = threshold;
+  }
+
+  // One step of a compaction pass, which slides the movable blocks toward the beginning of the buffer and lowers the bump pointer
+  // at the end of the pass, so the space of free blocks comes back as one piece. A step starts where the last one stopped and visits blocks
+  // until it moved budget bytes, every block visited costs its header. The space left in front of a pinned block, or where a step stops,
+  // is freed as a block, unless the size classes have no slot for its size: then it stays allocated until the next pass takes it.
+  // Every allocated block of the heap has to be known to the relocator. Returns the bytes moved.
+  size_t Compact(size_t budget, const BlockRelocator &relocator) noexcept;
+
+  // Whether a compaction pass stopped in the middle of the heap
+  bool IsCompacting() const noexcept {
+    return compact_cursor_;
+  }
+
+  // Bytes cut from the buffer so far, including block headers and free blocks.
+  size_t HeapExtent() const noexcept {
+    return static_cast<size_t>(current_ - buffer_begin_);
+  }
+
+  // Calls visitor(ptr, size, free) for every block from the beginning of the buffer up to the bump pointer.
+  // Free blocks carry a mark in their headers for the time of the walk, so the visitor must not call the allocator.
+  // Linear in the number of blocks and allocates nothing; a corrupted heap is for Validate.
+  template<class Visitor>
+  void ForEachBlock(Visitor &&visitor) noexcept {
+    size_t free_blocks = 0;
+    SetFreeBlockMarks(true, free_blocks);
+    for (uint8_t *block = buffer_begin_; block != current_;) {
+      auto *memory_block = reinterpret_cast<MemoryBlock *>(block);
+      const size_t size = memory_block->GetUnmarkedBlockSize();
+      visitor(static_cast<void *>(memory_block->UserMemoryBegin()), size, memory_block->IsMarked());
+      block = memory_block->UserMemoryBegin() + size;
+    }
+    SetFreeBlockMarks(false, free_blocks);
+  }
+
+  // Checks that the blocks tile the buffer up to the bump pointer, the red-black invariants of the tree,
+  // and that every free block is listed once, in the slot or the tree of its size, in the unsorted bin or among the deferred ones.
+  // Linear in the number of blocks, so tests and debug builds can run it periodically. The heap is left as it was, whatever the result.
+  bool Validate() noexcept;
+
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+  // Cycles of sampled calls per allocation path, built with SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM only
+  LatencyHistograms &GetLatencyHistograms() noexcept {
+    return latency_histograms_;
+  }
+
+  const LatencyHistograms &GetLatencyHistograms() const noexcept {
+    return latency_histograms_;
+  }
+#endif
+
 private:
+  [[gnu::cold]] [[gnu::noinline]] void *AllocateSlow(size_t size) noexcept;
+  [[gnu::cold]] [[gnu::noinline]] void DeallocateSlow(void *ptr) noexcept;
+  [[gnu::cold]] [[gnu::noinline]] void *AllocateWithDeferred(size_t size, AllocationPath &path) noexcept;
+  [[gnu::noinline]] void OverflowUnsortedBin(MemoryBlock *memory_block) noexcept;
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+  void *AllocateSampled(size_t size) noexcept;
+  void DeallocateSampled(void *ptr) noexcept;
+#endif
+
+  void *AllocateImpl(size_t size, AllocationPath &path) noexcept;
+  void DeallocateImpl(void *ptr) noexcept;
+  void *ReallocateImpl(void *ptr, size_t new_size, AllocationPath &path) noexcept;
   uint8_t *CutBuffer(size_t size) noexcept;
+  void RollBackCurrent(uint8_t *current) noexcept;
+  MemoryBlock *RetrieveLargeBlock(size_t size, AllocationPath &path) noexcept;
+  bool SetFreeBlockMarks(bool marked, size_t &count) noexcept;
+  void UnlistFreeBlocks(const uint8_t *begin, const uint8_t *end, std::span<const bool> slots_touched, bool large_touched) noexcept;
+  void ReleaseGap(uint8_t *begin, uint8_t *end) noexcept;
 
-  constexpr static size_t MAX_SLOT_SIZE_{16 * 1024};
+#ifdef SIMPLE_ALLOCATOR_COMPACT_INDEX
+  // Large free blocks are indexed at the end of the buffer instead of inside themselves
+  using LargeBlockIndex = CompactBlockIndex;
+#else
+  using LargeBlockIndex = MemoryTree;
+#endif
 
-  std::array<MemorySlot, GetSlotIndex(MAX_SLOT_SIZE_)> slots_{};
-  MemoryTree memory_tree_;
+  std::array<MemorySlot, SizeClasses::COUNT> slots_{};
+  UnsortedBin unsorted_bin_;
+  LargeBlockIndex large_blocks_;
+  MemorySlot deferred_blocks_;
+  bool defer_free_{false};
+  size_t streaming_copy_threshold_{SimpleAllocatorTraits::STREAMING_COPY_THRESHOLD};
+  size_t slot_split_threshold_{SimpleAllocatorTraits::SLOT_SPLIT_THRESHOLD};
 
   uint8_t *buffer_begin_{nullptr};
   uint8_t *buffer_end_{nullptr};
   uint8_t *current_{nullptr};
+  // Where the compaction pass goes on, nullptr between passes
+  uint8_t *compact_cursor_{nullptr};
+
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+  LatencyHistograms latency_histograms_;
+#endif
 };
 
 #endif // SIMPLEALLOCATOR_H
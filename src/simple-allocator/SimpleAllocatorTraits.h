@@ -2,10 +2,26 @@
 #ifndef SIMPLEALLOCATORTRAITS_H
 #define SIMPLEALLOCATORTRAITS_H
 #include <cstddef>
+#include <limits>
 
 class SimpleAllocatorTraits {
 public:
   static constexpr size_t ALIGNMENT = 16;
+  // Smaller blocks are kept in slots by size class, larger ones in the tree
+  static constexpr size_t MAX_SLOT_SIZE = 16 * 1024;
+  // Reallocate moves at least this many bytes with StreamingCopy, off: a grown block is written right after its move
+  static constexpr size_t STREAMING_COPY_THRESHOLD = std::numeric_limits<size_t>::max();
+  // Rests of split tree blocks under the slot sizes from this many bytes on go to a slot, off: a tree block cut for one never merges back
+  static constexpr size_t SLOT_SPLIT_THRESHOLD = std::numeric_limits<size_t>::max();
+  // A block which Reallocate had to move to grow more than this many times is moved with as much headroom as its new size,
+  // so the growth after that stays in place. A single move, as when a buffer is built once, takes no more than it asks for.
+  static constexpr size_t GROWTH_MOVES_WITHOUT_HEADROOM = 1;
+  // Bytes of blocks of each slot size a CPU of PerCpuSimpleAllocator keeps, at least one block
+  static constexpr size_t PER_CPU_CACHE_SIZE = 32 * 1024;
+  // Most blocks a CPU cache of PerCpuSimpleAllocator takes from the allocator or gives back under one lock
+  static constexpr size_t PER_CPU_CACHE_BATCH = 32;
+  // Large blocks freed last, checked before the index of large free blocks and sorted into it when the bin overflows or misses
+  static constexpr size_t UNSORTED_BIN_SIZE = 8;
 
   static_assert(ALIGNMENT && ((ALIGNMENT - 1) & ALIGNMENT) == 0, "power of 2 is expected");
 };
@@ -0,0 +1,63 @@
+// Simple Allocator 2024
+#ifndef SIZECLASSES_H
+#define SIZECLASSES_H
+#include "SimpleAllocatorTraits.h"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+// Built with SIMPLE_ALLOCATOR_SIZE_CLASSES_HEADER the slot sizes come from a table made by generate-size-classes
+// out of a size profile of the workload, it defines PROFILED_SIZE_CLASSES.
+#ifdef SIMPLE_ALLOCATOR_SIZE_CLASSES_HEADER
+#include SIMPLE_ALLOCATOR_SIZE_CLASSES_HEADER
+#endif
+
+// Block sizes of the slots in ascending order. A request is rounded up to the size of its class,
+// so every block in a slot fits every request of the slot.
+class SizeClasses {
+public:
+#ifdef SIMPLE_ALLOCATOR_SIZE_CLASSES_HEADER
+  static constexpr auto SIZES = PROFILED_SIZE_CLASSES;
+#else
+  // Every aligned size has its own class
+  static constexpr auto SIZES = [] {
+    std::array<uint32_t, SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT - 1> sizes{};
+    for (size_t i = 0; i != sizes.size(); ++i) {
+      sizes[i] = static_cast<uint32_t>((i + 1) * SimpleAllocatorTraits::ALIGNMENT);
+    }
+    return sizes;
+  }();
+#endif
+
+  static constexpr size_t COUNT = SIZES.size();
+
+  // A class per aligned size, the index is computed instead of looked up
+  static constexpr bool IS_LINEAR = COUNT == SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT - 1;
+
+  static_assert(
+    [] {
+      for (size_t i = 0; i != COUNT; ++i) {
+        if (!SIZES[i] || SIZES[i] % SimpleAllocatorTraits::ALIGNMENT || (i && SIZES[i] <= SIZES[i - 1])) {
+          return false;
+        }
+      }
+      return COUNT && SIZES[COUNT - 1] == SimpleAllocatorTraits::MAX_SLOT_SIZE - SimpleAllocatorTraits::ALIGNMENT;
+    }(),
+    "size classes must be ascending aligned sizes up to the largest slot block");
+
+  // Class index of every aligned size below MAX_SLOT_SIZE, by size / ALIGNMENT
+  static constexpr auto INDICES = [] {
+    std::array<std::conditional_t<COUNT <= UINT8_MAX, uint8_t, uint16_t>, SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT> indices{};
+    size_t index = 0;
+    for (size_t n = 1; n != indices.size(); ++n) {
+      while (SIZES[index] < n * SimpleAllocatorTraits::ALIGNMENT) {
+        ++index;
+      }
+      indices[n] = static_cast<typename decltype(indices)::value_type>(index);
+    }
+    return indices;
+  }();
+};
+
+#endif // SIZECLASSES_H
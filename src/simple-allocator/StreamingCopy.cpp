@@ -0,0 +1,87 @@
+// Simple Allocator 2024
+#include "StreamingCopy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined(__x86_64__)
+// Far enough ahead to cover the latency of memory, close enough to stay within the line fill buffers
+constexpr size_t PREFETCH_DISTANCE = 512;
+
+// 4 vectors per iteration, bytes is a multiple of that
+void StreamVectorsSse2(uint8_t *to, const uint8_t *from, size_t bytes) noexcept {
+  for (const uint8_t *end = from + bytes; from != end; from += 64, to += 64) {
+    _mm_prefetch(reinterpret_cast<const char *>(from + PREFETCH_DISTANCE), _MM_HINT_NTA);
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from + 16));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from + 32));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(to), a);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(to + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(to + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(to + 48), d);
+  }
+}
+
+[[gnu::target("avx2")]] void StreamVectorsAvx2(uint8_t *to, const uint8_t *from, size_t bytes) noexcept {
+  for (const uint8_t *end = from + bytes; from != end; from += 128, to += 128) {
+    _mm_prefetch(reinterpret_cast<const char *>(from + PREFETCH_DISTANCE), _MM_HINT_NTA);
+    _mm_prefetch(reinterpret_cast<const char *>(from + PREFETCH_DISTANCE + 64), _MM_HINT_NTA);
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from + 32));
+    const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from + 64));
+    const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(to), a);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(to + 32), b);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(to + 64), c);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(to + 96), d);
+  }
+}
+
+// Copies the head up to the alignment of the destination with memcpy, then whole iterations of vectors, then the tail
+template<size_t VECTOR_SIZE>
+void StreamingCopyWith(void (*stream_vectors)(uint8_t *to, const uint8_t *from, size_t bytes), void *destination, const void *source, size_t size) noexcept {
+  auto *to = static_cast<uint8_t *>(destination);
+  const auto *from = static_cast<const uint8_t *>(source);
+  const size_t head = std::min((VECTOR_SIZE - reinterpret_cast<uintptr_t>(to) % VECTOR_SIZE) % VECTOR_SIZE, size);
+  std::memcpy(to, from, head);
+  to += head;
+  from += head;
+  size -= head;
+
+  const size_t body = size / (4 * VECTOR_SIZE) * (4 * VECTOR_SIZE);
+  stream_vectors(to, from, body);
+  // Streaming stores are weakly ordered, the fence makes them visible before the block is handed out
+  _mm_sfence();
+  std::memcpy(to + body, from + body, size - body);
+}
+#endif
+
+} // namespace
+
+void StreamingCopy(void *destination, const void *source, size_t size) noexcept {
+#if defined(__x86_64__)
+  // A load and a test of the features libgcc detected at startup
+  if (__builtin_cpu_supports("avx2")) {
+    return StreamingCopyWith<32>(StreamVectorsAvx2, destination, source, size);
+  }
+  return StreamingCopyWith<16>(StreamVectorsSse2, destination, source, size);
+#else
+  std::memcpy(destination, source, size);
+#endif
+}
+
+const char *GetStreamingCopyName() noexcept {
+#if defined(__x86_64__)
+  return __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+#else
+  return "memcpy";
+#endif
+}
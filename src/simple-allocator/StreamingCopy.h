@@ -0,0 +1,14 @@
+// Simple Allocator 2024
+#ifndef STREAMINGCOPY_H
+#define STREAMINGCOPY_H
+#include <cstddef>
+
+// Copy for moving a large block out of memory which is freed right after. The source is prefetched as non-temporal
+// and the destination is written with non-temporal stores, so a move of a few hundred KiB doesn't flush the working set
+// out of the caches. The widest stores the CPU supports are picked at runtime: AVX2 or SSE2 on x86-64, std::memcpy elsewhere.
+void StreamingCopy(void *destination, const void *source, size_t size) noexcept;
+
+// The name of the copy StreamingCopy picked on this CPU
+const char *GetStreamingCopyName() noexcept;
+
+#endif // STREAMINGCOPY_H
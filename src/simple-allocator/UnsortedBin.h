@@ -0,0 +1,88 @@
+// Simple Allocator 2024
+#ifndef UNSORTEDBIN_H
+#define UNSORTEDBIN_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+#include "MemoryBlock.h"
+#include "SimpleAllocatorTraits.h"
+
+// The last few large blocks freed, in front of the index of large free blocks as in dlmalloc. A block freed and allocated again
+// at about the same size, like a buffer per request, is reused from here without a round trip through the index.
+// The pairs live in the allocator, so a lookup reads neither the index nor the free memory.
+class UnsortedBin {
+public:
+  static constexpr size_t CAPACITY = SimpleAllocatorTraits::UNSORTED_BIN_SIZE;
+
+  bool IsEmpty() const noexcept {
+    return !count_;
+  }
+
+  bool IsFull() const noexcept {
+    return count_ == CAPACITY;
+  }
+
+  void AddBlock(MemoryBlock *memory_block) noexcept {
+    entries_[count_++] = {memory_block->GetBlockSize(), memory_block};
+  }
+
+  // The last block freed which fits the size with at most an eighth of it left over, the whole block is handed out
+  MemoryBlock *RetrieveBlock(size_t size) noexcept {
+    const size_t max_size = size + std::min(size / 8, SimpleAllocatorTraits::MAX_SLOT_SIZE);
+    for (size_t i = count_; i != 0; --i) {
+      if (entries_[i - 1].size >= size && entries_[i - 1].size <= max_size) {
+        MemoryBlock *memory_block = entries_[i - 1].block;
+        for (; i != count_; ++i) {
+          entries_[i - 1] = entries_[i];
+        }
+        --count_;
+        return memory_block;
+      }
+    }
+    return nullptr;
+  }
+
+  // Drops the blocks for which predicate(memory_block) is true, the rest keeps its order
+  template<class Predicate>
+  void RemoveIf(Predicate &&predicate) noexcept {
+    size_t kept = 0;
+    for (size_t i = 0; i != count_; ++i) {
+      if (!predicate(entries_[i].block)) {
+        entries_[kept++] = entries_[i];
+      }
+    }
+    count_ = kept;
+  }
+
+  // Empties the bin into the index, oldest first
+  template<class Index>
+  void SortInto(Index &index) noexcept {
+    for (size_t i = 0; i != count_; ++i) {
+      index.InsertBlock(entries_[i].block);
+    }
+    count_ = 0;
+  }
+
+  // Calls visitor(memory_block, size) with the size the bin keeps for the block, a visitor returning false stops the walk
+  template<class Visitor>
+  bool ForEach(Visitor &&visitor) const noexcept {
+    for (size_t i = 0; i != count_; ++i) {
+      if (!visitor(entries_[i].block, entries_[i].size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Entry {
+    size_t size;
+    MemoryBlock *block;
+  };
+
+  std::array<Entry, CAPACITY> entries_{};
+  size_t count_{0};
+};
+
+#endif // UNSORTEDBIN_H
@@ -0,0 +1,48 @@
+#include "AddressOwnershipMap.h"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+TEST(AddressOwnershipMapTest, RegionsAreAlignedToGranules) {
+  auto map = std::make_unique<AddressOwnershipMap>();
+  constexpr size_t size = AddressOwnershipMap::GRANULE_SIZE + 1;
+  auto *region = static_cast<uint8_t *>(map->MapRegion(size, AddressOwner::BENCHMARK_HEAP));
+  ASSERT_NE(region, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(region) % AddressOwnershipMap::GRANULE_SIZE, 0);
+  std::memset(region, 1, size);
+
+  EXPECT_EQ(map->Lookup(region), AddressOwner::BENCHMARK_HEAP);
+  EXPECT_EQ(map->Lookup(region + size - 1), AddressOwner::BENCHMARK_HEAP);
+  EXPECT_EQ(map->Lookup(region + 2 * AddressOwnershipMap::GRANULE_SIZE - 1), AddressOwner::BENCHMARK_HEAP);
+  EXPECT_EQ(map->Lookup(region + 2 * AddressOwnershipMap::GRANULE_SIZE), AddressOwner::FOREIGN);
+  EXPECT_EQ(map->Lookup(region - 1), AddressOwner::FOREIGN);
+
+  map->ReleaseRegion(region, size);
+  EXPECT_EQ(map->Lookup(region), AddressOwner::RELEASED_HEAP);
+  munmap(region, 2 * AddressOwnershipMap::GRANULE_SIZE);
+}
+
+TEST(AddressOwnershipMapTest, OldestReleasedRegionIsUnmapped) {
+  auto map = std::make_unique<AddressOwnershipMap>();
+  std::vector<void *> regions;
+  for (size_t i = 0; i != AddressOwnershipMap::RETIRED_REGIONS + 1; ++i) {
+    regions.push_back(map->MapRegion(AddressOwnershipMap::GRANULE_SIZE, AddressOwner::BENCHMARK_HEAP));
+    ASSERT_NE(regions.back(), nullptr);
+    map->ReleaseRegion(regions.back(), AddressOwnershipMap::GRANULE_SIZE);
+  }
+  EXPECT_EQ(map->Lookup(regions.front()), AddressOwner::FOREIGN);
+  for (size_t i = 1; i != regions.size(); ++i) {
+    EXPECT_EQ(map->Lookup(regions[i]), AddressOwner::RELEASED_HEAP);
+    munmap(regions[i], AddressOwnershipMap::GRANULE_SIZE);
+  }
+}
+
+TEST(AddressOwnershipMapTest, UnknownAddressesAreForeign) {
+  auto map = std::make_unique<AddressOwnershipMap>();
+  int on_stack = 0;
+  EXPECT_EQ(map->Lookup(nullptr), AddressOwner::FOREIGN);
+  EXPECT_EQ(map->Lookup(&on_stack), AddressOwner::FOREIGN);
+  EXPECT_EQ(map->Lookup(reinterpret_cast<void *>(~uintptr_t{0})), AddressOwner::FOREIGN);
+}
@@ -0,0 +1,148 @@
+#include "CompactBlockIndex.h"
+#include "MemoryBlock.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <sanitizer/asan_interface.h>
+#include <set>
+#include <vector>
+
+namespace {
+
+constexpr size_t BLOCKS = 2000;
+constexpr size_t MIN_BLOCK_SIZE = SimpleAllocatorTraits::MAX_SLOT_SIZE;
+
+// A heap of large blocks of a few dozen sizes, with the index of its free blocks
+struct TestHeap {
+  TestHeap() {
+    std::mt19937_64 generator{3};
+    for (size_t i = 0; i != BLOCKS; ++i) {
+      sizes.push_back(MIN_BLOCK_SIZE + 16 * (generator() % 40));
+      heap_size += sizeof(MemoryBlock) + sizes.back();
+    }
+    heap = std::make_unique<uint8_t[]>(heap_size + SimpleAllocatorTraits::ALIGNMENT);
+    metadata_size = CompactBlockIndex::RequiredSize(heap_size);
+    metadata = std::make_unique<uint64_t[]>(metadata_size / sizeof(uint64_t) + 1);
+    EXPECT_TRUE(index.Init(metadata.get(), metadata_size, heap_size));
+
+    auto *block = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(heap.get()) + 15) & ~uintptr_t{15});
+    begin = block;
+    for (size_t size : sizes) {
+      blocks.push_back(new (block) MemoryBlock{size});
+      block = blocks.back()->UserMemoryEnd();
+    }
+    end = block;
+  }
+
+  // The index must not read the free memory
+  void Insert(MemoryBlock *memory_block) {
+    ASAN_POISON_MEMORY_REGION(memory_block->UserMemoryBegin(), memory_block->GetBlockSize());
+    index.InsertBlock(memory_block);
+  }
+
+  MemoryBlock *Retrieve(size_t size) {
+    MemoryBlock *memory_block = index.RetrieveBlock(size);
+    if (memory_block) {
+      ASAN_UNPOISON_MEMORY_REGION(memory_block->UserMemoryBegin(), memory_block->GetBlockSize());
+    }
+    return memory_block;
+  }
+
+  std::vector<size_t> sizes;
+  size_t heap_size{0};
+  std::unique_ptr<uint8_t[]> heap;
+  size_t metadata_size{0};
+  std::unique_ptr<uint64_t[]> metadata;
+  const void *begin{nullptr};
+  const void *end{nullptr};
+  std::vector<MemoryBlock *> blocks;
+  CompactBlockIndex index;
+};
+
+} // namespace
+
+TEST(CompactBlockIndexTest, SmallHeapNeedsNoMetadata) {
+  EXPECT_EQ(CompactBlockIndex::RequiredSize(MIN_BLOCK_SIZE), 0);
+  EXPECT_GT(CompactBlockIndex::RequiredSize(sizeof(MemoryBlock) + MIN_BLOCK_SIZE), 0);
+
+  CompactBlockIndex index;
+  EXPECT_TRUE(index.Init(nullptr, 0, MIN_BLOCK_SIZE));
+  EXPECT_EQ(index.RetrieveBlock(MIN_BLOCK_SIZE), nullptr);
+}
+
+TEST(CompactBlockIndexTest, RetrievesBestFitLastInFirstOut) {
+  TestHeap heap;
+  // Free blocks of every size in the order they were inserted
+  std::map<size_t, std::vector<MemoryBlock *>> reference;
+  std::set<MemoryBlock *> free_blocks;
+  const auto insert = [&](MemoryBlock *memory_block) {
+    if (free_blocks.insert(memory_block).second) {
+      reference[memory_block->GetBlockSize()].push_back(memory_block);
+      heap.Insert(memory_block);
+    }
+  };
+  for (MemoryBlock *memory_block : heap.blocks) {
+    insert(memory_block);
+  }
+  EXPECT_TRUE(heap.index.Validate(heap.begin, heap.end, BLOCKS));
+
+  std::mt19937_64 generator{7};
+  for (size_t i = 0; i != 10 * BLOCKS; ++i) {
+    if (generator() % 2) {
+      const size_t size = MIN_BLOCK_SIZE + 16 * (generator() % 48);
+      const auto expected = reference.lower_bound(size);
+      MemoryBlock *memory_block = heap.Retrieve(size);
+      if (expected == reference.end()) {
+        ASSERT_EQ(memory_block, nullptr);
+        continue;
+      }
+      ASSERT_EQ(memory_block, expected->second.back());
+      free_blocks.erase(memory_block);
+      expected->second.pop_back();
+      if (expected->second.empty()) {
+        reference.erase(expected);
+      }
+    } else {
+      insert(heap.blocks[generator() % BLOCKS]);
+    }
+    if (i % 1000 == 0) {
+      ASSERT_TRUE(heap.index.Validate(heap.begin, heap.end, BLOCKS));
+    }
+  }
+
+  // Emptied and filled again from the other end
+  while (heap.Retrieve(MIN_BLOCK_SIZE)) {
+  }
+  EXPECT_TRUE(heap.index.Validate(heap.begin, heap.end, BLOCKS));
+  std::for_each(heap.blocks.rbegin(), heap.blocks.rend(), [&heap](MemoryBlock *memory_block) { heap.Insert(memory_block); });
+  EXPECT_TRUE(heap.index.Validate(heap.begin, heap.end, BLOCKS));
+  for (MemoryBlock *memory_block : heap.blocks) {
+    ASAN_UNPOISON_MEMORY_REGION(memory_block->UserMemoryBegin(), memory_block->GetBlockSize());
+  }
+}
+
+TEST(CompactBlockIndexTest, RemovesGivenBlocks) {
+  TestHeap heap;
+  for (MemoryBlock *memory_block : heap.blocks) {
+    heap.Insert(memory_block);
+  }
+  std::set<MemoryBlock *> kept_blocks;
+  for (size_t i = 0; i != BLOCKS; ++i) {
+    if (i % 3) {
+      kept_blocks.insert(heap.blocks[i]);
+    } else {
+      ASSERT_TRUE(heap.index.RemoveBlock(heap.blocks[i]));
+      EXPECT_FALSE(heap.index.RemoveBlock(heap.blocks[i]));
+      ASAN_UNPOISON_MEMORY_REGION(heap.blocks[i]->UserMemoryBegin(), heap.blocks[i]->GetBlockSize());
+    }
+  }
+  EXPECT_TRUE(heap.index.Validate(heap.begin, heap.end, BLOCKS));
+
+  while (MemoryBlock *memory_block = heap.Retrieve(MIN_BLOCK_SIZE)) {
+    EXPECT_EQ(kept_blocks.erase(memory_block), 1);
+  }
+  EXPECT_TRUE(kept_blocks.empty());
+}
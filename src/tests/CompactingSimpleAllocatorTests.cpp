@@ -0,0 +1,171 @@
+#include "CompactingSimpleAllocator.h"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = 16 * 1024 * 1024;
+
+// Sizes of every slot range and a few large blocks, every block filled with the byte of its position
+std::vector<Handle> AllocateFilled(CompactingSimpleAllocator &alloc, size_t count) {
+  std::vector<Handle> handles;
+  for (size_t i = 0; i != count; ++i) {
+    const size_t size = i % 50 == 49 ? 20000 + i * 16 : 16 + i * 48 % 2000;
+    handles.push_back(alloc.Allocate(size));
+    EXPECT_TRUE(handles.back());
+    std::memset(alloc.Pin(handles.back()), static_cast<int>(i & 0xff), size);
+    alloc.Unpin(handles.back());
+  }
+  return handles;
+}
+
+bool HasFilling(CompactingSimpleAllocator &alloc, Handle handle, size_t i) {
+  const auto *memory = static_cast<const uint8_t *>(alloc.Pin(handle));
+  const size_t size = i % 50 == 49 ? 20000 + i * 16 : 16 + i * 48 % 2000;
+  bool filled = true;
+  for (size_t offset = 0; offset != size; ++offset) {
+    filled = filled && memory[offset] == (i & 0xff);
+  }
+  alloc.Unpin(handle);
+  return filled;
+}
+
+} // namespace
+
+TEST(CompactingSimpleAllocatorTest, CompactSlidesBlocksAndLowersHeap) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<CompactingSimpleAllocator>();
+  ASSERT_TRUE(alloc->Init(buffer.get(), BUFFER_SIZE, 4096));
+  EXPECT_FALSE(alloc->Init(buffer.get(), BUFFER_SIZE, 4096));
+
+  std::vector<Handle> handles = AllocateFilled(*alloc, 1000);
+  size_t live_size = 0;
+  for (size_t i = 0; i != handles.size(); ++i) {
+    if (i % 2) {
+      live_size += sizeof(MemoryBlock) + alloc->Size(handles[i]);
+    } else {
+      alloc->Deallocate(handles[i]);
+    }
+  }
+  EXPECT_GT(alloc->HeapExtent(), live_size + live_size / 4);
+
+  EXPECT_GT(alloc->Compact(SIZE_MAX), 0);
+  EXPECT_FALSE(alloc->IsCompacting());
+  EXPECT_EQ(alloc->HeapExtent(), live_size);
+  EXPECT_TRUE(alloc->Validate());
+  for (size_t i = 1; i < handles.size(); i += 2) {
+    EXPECT_TRUE(HasFilling(*alloc, handles[i], i)) << i;
+  }
+
+  // The freed space is bump memory again
+  Handle handle = alloc->Allocate(64);
+  EXPECT_EQ(static_cast<uint8_t *>(alloc->Pin(handle)), static_cast<uint8_t *>(alloc->Pin(handles[999])) + alloc->Size(handles[999]) + sizeof(MemoryBlock));
+  EXPECT_EQ(alloc->Compact(SIZE_MAX), 0);
+}
+
+TEST(CompactingSimpleAllocatorTest, IncrementalCompactionKeepsPinnedBlocks) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<CompactingSimpleAllocator>();
+  ASSERT_TRUE(alloc->Init(buffer.get(), BUFFER_SIZE, 4096));
+
+  std::vector<Handle> handles = AllocateFilled(*alloc, 1000);
+  std::vector<void *> pinned;
+  for (size_t i = 0; i != handles.size(); ++i) {
+    if (i % 3 == 0) {
+      alloc->Deallocate(handles[i]);
+      handles[i] = {};
+    } else if (i % 97 == 1) {
+      pinned.push_back(alloc->Pin(handles[i]));
+    }
+  }
+  const size_t extent = alloc->HeapExtent();
+
+  size_t steps = 0;
+  do {
+    alloc->Compact(4096);
+    ASSERT_TRUE(alloc->Validate());
+    // The allocator stays usable between the steps
+    Handle temporary = alloc->Allocate(100 + steps % 3 * 10000);
+    ASSERT_TRUE(temporary);
+    alloc->Deallocate(temporary);
+    ++steps;
+  } while (alloc->IsCompacting());
+  EXPECT_GT(steps, 10);
+  EXPECT_LT(alloc->HeapExtent(), extent);
+
+  size_t pinned_index = 0;
+  for (size_t i = 0; i != handles.size(); ++i) {
+    if (!handles[i]) {
+      continue;
+    }
+    EXPECT_TRUE(HasFilling(*alloc, handles[i], i)) << i;
+    if (i % 97 == 1) {
+      EXPECT_EQ(alloc->Pin(handles[i]), pinned[pinned_index++]);
+      alloc->Unpin(handles[i]);
+      alloc->Unpin(handles[i]);
+    }
+  }
+
+  // Unpinned, the second pass closes the gaps in front of them
+  const size_t pinned_extent = alloc->HeapExtent();
+  while (alloc->Compact(4096) || alloc->IsCompacting()) {
+  }
+  EXPECT_LT(alloc->HeapExtent(), pinned_extent);
+  EXPECT_TRUE(alloc->Validate());
+}
+
+TEST(CompactingSimpleAllocatorTest, HandlesAreLimited) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<CompactingSimpleAllocator>();
+  EXPECT_FALSE(alloc->Init(buffer.get(), 64, 4096));
+  ASSERT_TRUE(alloc->Init(buffer.get(), BUFFER_SIZE, 2));
+
+  Handle first = alloc->Allocate(64);
+  Handle second = alloc->Allocate(64);
+  EXPECT_TRUE(first);
+  EXPECT_TRUE(second);
+  EXPECT_FALSE(alloc->Allocate(64));
+  EXPECT_FALSE(alloc->Allocate(BUFFER_SIZE));
+  alloc->Deallocate(first);
+  Handle third = alloc->Allocate(64);
+  EXPECT_EQ(third.index, first.index);
+  EXPECT_EQ(alloc->Pin(Handle{}), nullptr);
+}
+
+TEST(CompactingSimpleAllocatorTest, FreesBelowCursorRestartPass) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<CompactingSimpleAllocator>();
+  ASSERT_TRUE(alloc->Init(buffer.get(), BUFFER_SIZE, 4096));
+
+  std::vector<Handle> handles;
+  for (size_t i = 0; i != 8; ++i) {
+    handles.push_back(alloc->Allocate(64));
+  }
+  alloc->Deallocate(handles[0]);
+  alloc->Compact(100);
+  ASSERT_TRUE(alloc->IsCompacting());
+  Handle gap = alloc->Allocate(64);
+
+  // The heap rolls back below where the pass stopped, then a block is cut over it
+  for (size_t i = 7; i != 1; --i) {
+    alloc->Deallocate(handles[i]);
+  }
+  alloc->Deallocate(gap);
+  alloc->Deallocate(handles[1]);
+  Handle large = alloc->Allocate(1000);
+  ASSERT_TRUE(large);
+  std::memset(alloc->Pin(large), 0x5a, 1000);
+  alloc->Unpin(large);
+
+  while (alloc->Compact(1 << 20) || alloc->IsCompacting()) {
+  }
+  EXPECT_TRUE(alloc->Validate());
+  EXPECT_EQ(alloc->HeapExtent(), sizeof(MemoryBlock) + alloc->Size(large));
+  const auto *memory = static_cast<const uint8_t *>(alloc->Pin(large));
+  EXPECT_EQ(memory[0], 0x5a);
+  EXPECT_EQ(memory[999], 0x5a);
+  alloc->Unpin(large);
+}
@@ -0,0 +1,104 @@
+#include "GuardedPool.h"
+
+#include <csetjmp>
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace {
+
+// The pool keeps the fault handlers, so every test runs it in a death test child
+struct TestPool {
+  TestPool(size_t slots_count) {
+    if (!pool->Init(*map, slots_count, 1)) {
+      std::abort();
+    }
+  }
+
+  std::unique_ptr<AddressOwnershipMap> map = std::make_unique<AddressOwnershipMap>();
+  std::unique_ptr<GuardedPool> pool = std::make_unique<GuardedPool>();
+};
+
+} // namespace
+
+TEST(GuardedPoolTest, SampledAllocationsEndAtTheGuardPage) {
+  EXPECT_EXIT(
+    {
+      TestPool test{2};
+      EXPECT_TRUE(test.pool->ShouldSample());
+      auto *ptr = static_cast<uint8_t *>(test.pool->Allocate(24));
+      EXPECT_EQ(test.map->Lookup(ptr), AddressOwner::GUARDED_POOL);
+      EXPECT_EQ(test.pool->Size(ptr), 32);
+      EXPECT_EQ((reinterpret_cast<uintptr_t>(ptr) + 32) % static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)), 0);
+      std::memset(ptr, 1, 32);
+
+      // Both slots are taken, and a freed slot is reused only after the one freed before it
+      void *second = test.pool->Allocate(16);
+      EXPECT_NE(second, nullptr);
+      EXPECT_EQ(test.pool->Allocate(16), nullptr);
+      test.pool->Deallocate(second);
+      test.pool->Deallocate(ptr);
+      EXPECT_EQ(test.pool->Allocate(16), static_cast<uint8_t *>(second));
+      EXPECT_EQ(test.pool->Allocate(4096 * 1024), nullptr);
+      std::exit(::testing::Test::HasFailure() ? 1 : 0);
+    },
+    ::testing::ExitedWithCode(0), "");
+}
+
+TEST(GuardedPoolTest, OverflowIsReported) {
+  EXPECT_DEATH(
+    {
+      TestPool test{4};
+      auto *ptr = static_cast<volatile uint8_t *>(test.pool->Allocate(100));
+      ptr[112] = 1;
+    },
+    "heap-buffer-overflow at .*allocation of 100 bytes.*\nAllocated by:");
+}
+
+TEST(GuardedPoolTest, FaultsElsewhereGoToThePreviousHandler) {
+  EXPECT_DEATH(
+    {
+      // A runtime which recovers from its own faults once, the second one ends the process
+      static sigjmp_buf recovery;
+      static volatile bool recovering = true;
+      struct sigaction action {};
+      action.sa_handler = [](int) {
+        if (recovering) {
+          recovering = false;
+          siglongjmp(recovery, 1);
+        }
+        signal(SIGSEGV, SIG_DFL);
+      };
+      sigaction(SIGSEGV, &action, nullptr);
+
+      TestPool test{4};
+      auto *page = static_cast<volatile uint8_t *>(mmap(nullptr, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+      if (!sigsetjmp(recovery, 1)) {
+        page[0] = 1;
+      }
+      auto *ptr = static_cast<volatile uint8_t *>(test.pool->Allocate(100));
+      ptr[112] = 1;
+    },
+    "heap-buffer-overflow at .*allocation of 100 bytes");
+}
+
+TEST(GuardedPoolTest, UseAfterFreeIsReported) {
+  EXPECT_DEATH(
+    {
+      TestPool test{4};
+      auto *ptr = static_cast<volatile uint8_t *>(test.pool->Allocate(64));
+      test.pool->Deallocate(const_cast<uint8_t *>(ptr));
+      ptr[0] = 1;
+    },
+    "use-after-free at .*allocation of 64 bytes.*\nAllocated by:.*Freed by:");
+}
+
+TEST(GuardedPoolTest, DoubleFreeIsReported) {
+  EXPECT_DEATH(
+    {
+      TestPool test{4};
+      void *ptr = test.pool->Allocate(64);
+      test.pool->Deallocate(ptr);
+      test.pool->Deallocate(ptr);
+    },
+    "double-free");
+}
@@ -0,0 +1,78 @@
+#include "HintedMemoryResource.h"
+#include "HintedSimpleAllocator.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = 3 * 1024 * 1024;
+
+} // namespace
+
+TEST(HintedSimpleAllocatorTest, HintsUseSeparateRegions) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<HintedSimpleAllocator>();
+  EXPECT_FALSE(alloc->Init(buffer.get(), 16));
+  ASSERT_TRUE(alloc->Init(buffer.get(), BUFFER_SIZE));
+  EXPECT_FALSE(alloc->Init(buffer.get(), BUFFER_SIZE));
+
+  void *long_lived = alloc->Allocate(64);
+  void *short_lived = alloc->Allocate(64, AllocationHint::SHORT_LIVED);
+  void *bulk = alloc->Allocate(256 * 1024, AllocationHint::BULK);
+  ASSERT_NE(long_lived, nullptr);
+  ASSERT_NE(short_lived, nullptr);
+  ASSERT_NE(bulk, nullptr);
+  EXPECT_LT(long_lived, short_lived);
+  EXPECT_LT(short_lived, bulk);
+  EXPECT_GE(static_cast<uint8_t *>(short_lived) - static_cast<uint8_t *>(long_lived), BUFFER_SIZE / 3 - 16);
+  const size_t short_lived_extent = sizeof(MemoryBlock) + HintedSimpleAllocator::Size(short_lived);
+  EXPECT_EQ(alloc->HeapExtent(AllocationHint::SHORT_LIVED), short_lived_extent);
+  EXPECT_EQ(alloc->HeapExtent(), sizeof(MemoryBlock) + HintedSimpleAllocator::Size(long_lived) + short_lived_extent + sizeof(MemoryBlock) + 256 * 1024);
+
+  // Only one region has enough space left for the bulk buffer
+  EXPECT_EQ(alloc->Allocate(BUFFER_SIZE / 3 - 16 * 1024, AllocationHint::BULK), nullptr);
+  EXPECT_NE(alloc->Allocate(BUFFER_SIZE / 3 - 16 * 1024, AllocationHint::SHORT_LIVED), nullptr);
+}
+
+TEST(HintedSimpleAllocatorTest, BlocksReturnToTheirRegion) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<HintedSimpleAllocator>();
+  alloc->Init(buffer.get(), BUFFER_SIZE);
+
+  void *short_lived = alloc->Allocate(64, AllocationHint::SHORT_LIVED);
+  void *short_lived_pin = alloc->Allocate(16, AllocationHint::SHORT_LIVED);
+  alloc->Deallocate(short_lived);
+  EXPECT_NE(alloc->Allocate(64), short_lived);
+  EXPECT_EQ(alloc->Allocate(64, AllocationHint::SHORT_LIVED), short_lived);
+
+  void *grown = alloc->Reallocate(short_lived_pin, 1024);
+  EXPECT_EQ(grown, short_lived_pin);
+  const size_t blocks_size = HintedSimpleAllocator::Size(short_lived) + HintedSimpleAllocator::Size(grown);
+  EXPECT_EQ(alloc->HeapExtent(AllocationHint::SHORT_LIVED), 2 * sizeof(MemoryBlock) + blocks_size);
+
+  void *moved = alloc->Reallocate(short_lived, 4096);
+  EXPECT_GT(moved, grown);
+  EXPECT_LT(moved, static_cast<void *>(buffer.get() + 2 * BUFFER_SIZE / 3));
+}
+
+TEST(HintedSimpleAllocatorTest, MemoryResourceAllocatesWithItsHint) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  auto alloc = std::make_unique<HintedSimpleAllocator>();
+  alloc->Init(buffer.get(), BUFFER_SIZE);
+  HintedMemoryResource short_lived{*alloc, AllocationHint::SHORT_LIVED};
+  HintedMemoryResource bulk{*alloc, AllocationHint::BULK};
+  EXPECT_TRUE(short_lived.is_equal(bulk));
+  EXPECT_FALSE(short_lived.is_equal(*std::pmr::new_delete_resource()));
+
+  {
+    std::pmr::vector<int> numbers{&short_lived};
+    numbers.resize(1000);
+    EXPECT_GT(alloc->HeapExtent(AllocationHint::SHORT_LIVED), 4000);
+    EXPECT_EQ(alloc->HeapExtent(AllocationHint::LONG_LIVED), 0);
+  }
+  EXPECT_EQ(alloc->HeapExtent(AllocationHint::SHORT_LIVED), 0);
+  EXPECT_THROW(static_cast<void>(bulk.allocate(BUFFER_SIZE)), std::bad_alloc);
+  EXPECT_THROW(static_cast<void>(bulk.allocate(64, 64)), std::bad_alloc);
+}
@@ -0,0 +1,76 @@
+#include "LatencyHistogram.h"
+#include "SimpleAllocator.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+TEST(LatencyHistogramTest, BucketsCoverTheirValues) {
+  for (uint64_t value : {0ULL, 1ULL, 15ULL, 16ULL, 17ULL, 31ULL, 32ULL, 100ULL, 1000ULL, 123456789ULL, (1ULL << 41) - 1}) {
+    const size_t index = LatencyHistogram::GetBucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::BUCKETS_COUNT);
+    EXPECT_LE(LatencyHistogram::GetBucketLowerBound(index), value);
+    EXPECT_GE(LatencyHistogram::GetBucketUpperBound(index), value);
+    // The bucket width is at most 1/16 of its values
+    EXPECT_LE(LatencyHistogram::GetBucketUpperBound(index) - LatencyHistogram::GetBucketLowerBound(index), value / LatencyHistogram::SUB_BUCKETS);
+  }
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(~0ULL), LatencyHistogram::BUCKETS_COUNT - 1);
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  auto histogram = std::make_unique<LatencyHistogram>();
+  EXPECT_EQ(histogram->Percentile(50.0), 0);
+
+  for (uint64_t value = 1; value <= 1000; ++value) {
+    histogram->Record(value);
+  }
+  histogram->Record(1000000);
+
+  EXPECT_EQ(histogram->Count(), 1001);
+  EXPECT_EQ(histogram->Max(), 1000000);
+  EXPECT_NEAR(static_cast<double>(histogram->Percentile(50.0)), 501.0, 501.0 / 16);
+  EXPECT_NEAR(static_cast<double>(histogram->Percentile(99.0)), 991.0, 991.0 / 16);
+  EXPECT_EQ(histogram->Percentile(100.0), 1000000);
+
+  histogram->Reset();
+  EXPECT_EQ(histogram->Count(), 0);
+}
+
+#ifdef SIMPLE_ALLOCATOR_LATENCY_HISTOGRAM
+TEST(LatencyHistogramTest, AllocatorRecordsEveryPath) {
+  auto alloc = std::make_unique<SimpleAllocator>();
+  auto buffer = std::make_unique<uint8_t[]>(1024 * 1024);
+  alloc->Init(buffer.get(), 1024 * 1024);
+  auto &histograms = alloc->GetLatencyHistograms();
+  histograms.SetSamplingPeriod(1);
+
+  void *small = alloc->Allocate(64);
+  void *large = alloc->Allocate(64 * 1024);
+  void *last = alloc->Allocate(16);
+  alloc->Deallocate(small);
+  alloc->Deallocate(large);
+  EXPECT_EQ(alloc->Allocate(64), small);
+  EXPECT_EQ(alloc->Allocate(16 * 1024), large);
+  last = alloc->Reallocate(last, 32);
+  EXPECT_NE(alloc->Reallocate(small, 128), small);
+  alloc->Deallocate(large);
+  EXPECT_EQ(alloc->Allocate(16 * 1024), large);
+
+  EXPECT_EQ(histograms.Get(AllocationPath::SLOT_MISS).Count(), 2);
+  EXPECT_EQ(histograms.Get(AllocationPath::TREE_MISS).Count(), 1);
+  EXPECT_EQ(histograms.Get(AllocationPath::SLOT_HIT).Count(), 1);
+  EXPECT_EQ(histograms.Get(AllocationPath::BIN_HIT).Count(), 1);
+  EXPECT_EQ(histograms.Get(AllocationPath::TREE_HIT_SPLIT).Count(), 1);
+  EXPECT_EQ(histograms.Get(AllocationPath::DEALLOCATE).Count(), 3);
+  EXPECT_EQ(histograms.Get(AllocationPath::REALLOCATE_IN_PLACE).Count(), 1);
+  EXPECT_EQ(histograms.Get(AllocationPath::REALLOCATE_MOVE).Count(), 1);
+
+  histograms.Reset();
+  histograms.SetSamplingPeriod(16);
+  for (int i = 0; i != 8000; ++i) {
+    alloc->Deallocate(alloc->Allocate(32));
+  }
+  // Samples are spread over both calls of the loop
+  EXPECT_NEAR(static_cast<double>(histograms.Get(AllocationPath::SLOT_MISS).Count()), 500.0, 100.0);
+  EXPECT_NEAR(static_cast<double>(histograms.Get(AllocationPath::DEALLOCATE).Count()), 500.0, 100.0);
+}
+#endif
@@ -0,0 +1,88 @@
+#include "ObjectPool.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Node {
+  Node *prev{nullptr};
+  Node *next{nullptr};
+  int64_t value{0};
+
+  explicit Node(int64_t v) noexcept
+    : value(v) {}
+};
+
+struct Counted {
+  static inline int alive = 0;
+
+  Counted() noexcept {
+    ++alive;
+  }
+
+  ~Counted() noexcept {
+    --alive;
+  }
+};
+
+} // namespace
+
+TEST(ObjectPoolTest, ObjectsOfBatchAreAdjacent) {
+  SimpleAllocator alloc;
+  char buffer[16 * 1024];
+  alloc.Init(buffer, sizeof(buffer));
+  using Pool = ObjectPool<Node, 8>;
+  Pool pool{alloc};
+
+  Node *first = pool.Construct(1);
+  ASSERT_NE(first, nullptr);
+  for (int64_t i = 2; i <= 8; ++i) {
+    Node *node = pool.Construct(i);
+    ASSERT_EQ(reinterpret_cast<uint8_t *>(node), reinterpret_cast<uint8_t *>(first) + (i - 1) * Pool::OBJECT_SIZE);
+    EXPECT_EQ(node->value, i);
+  }
+}
+
+TEST(ObjectPoolTest, DestroyedObjectIsReused) {
+  SimpleAllocator alloc;
+  char buffer[16 * 1024];
+  alloc.Init(buffer, sizeof(buffer));
+  ObjectPool<Counted> pool{alloc};
+
+  Counted *object = pool.Construct();
+  EXPECT_EQ(Counted::alive, 1);
+  pool.Destroy(object);
+  EXPECT_EQ(Counted::alive, 0);
+  EXPECT_EQ(pool.Construct(), object);
+  pool.Destroy(object);
+}
+
+TEST(ObjectPoolTest, RefillsFromAllocatorAndReturnsBatches) {
+  auto buffer = std::make_unique<char[]>(1024 * 1024);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), 1024 * 1024);
+  {
+    ObjectPool<Node, 16> pool{alloc};
+    std::vector<Node *> nodes;
+    for (int64_t i = 0; i != 1000; ++i) {
+      nodes.push_back(pool.Construct(i));
+      ASSERT_NE(nodes.back(), nullptr);
+    }
+    for (int64_t i = 0; i != 1000; ++i) {
+      EXPECT_EQ(nodes[i]->value, i);
+      pool.Destroy(nodes[i]);
+    }
+    EXPECT_GT(alloc.HeapExtent(), 1000 * sizeof(Node));
+  }
+  EXPECT_EQ(alloc.HeapExtent(), 0);
+}
+
+TEST(ObjectPoolTest, ConstructReturnsNullIfNoMemory) {
+  SimpleAllocator alloc;
+  char buffer[256];
+  alloc.Init(buffer, sizeof(buffer));
+  ObjectPool<Node, 64> pool{alloc};
+  EXPECT_EQ(pool.Construct(1), nullptr);
+}
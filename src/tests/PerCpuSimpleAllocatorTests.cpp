@@ -0,0 +1,115 @@
+#include "PerCpuSimpleAllocator.h"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define RSEQ_HEADER_AVAILABLE
+#endif
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = 16 * 1024 * 1024;
+
+// Every thread allocates blocks of its own pattern, half of which another thread frees
+void RunThreads(PerCpuSimpleAllocator &alloc) {
+  constexpr size_t THREADS = 4;
+  constexpr size_t BLOCKS = 2000;
+  std::vector<std::vector<void *>> handed_over(THREADS);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t != THREADS; ++t) {
+    threads.emplace_back([&alloc, &handed_over, t] {
+      std::vector<void *> kept;
+      for (size_t i = 0; i != BLOCKS; ++i) {
+        const size_t size = 16 + (i * 37 + t) % 2048;
+        auto *memory = static_cast<uint8_t *>(alloc.Allocate(size));
+        ASSERT_NE(memory, nullptr);
+        std::memset(memory, static_cast<int>(t + 1), size);
+        (i % 2 ? kept : handed_over[t]).push_back(memory);
+      }
+      for (size_t i = 0; i != kept.size(); ++i) {
+        auto *memory = static_cast<uint8_t *>(kept[i]);
+        EXPECT_EQ(memory[0], t + 1);
+        alloc.Deallocate(memory);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (size_t t = 0; t != THREADS; ++t) {
+    threads.emplace_back([&alloc, &handed_over, t] {
+      for (void *memory : handed_over[(t + 1) % THREADS]) {
+        EXPECT_EQ(*static_cast<uint8_t *>(memory), (t + 1) % THREADS + 1);
+        alloc.Deallocate(memory);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace
+
+TEST(PerCpuSimpleAllocatorTest, CpuCacheReusesFreedBlocks) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  PerCpuSimpleAllocator alloc;
+  ASSERT_TRUE(alloc.Init(buffer.get(), BUFFER_SIZE));
+#ifdef RSEQ_HEADER_AVAILABLE
+  // Older glibc, or glibc.pthread.rseq=0, registers no rseq and the allocator takes the lock instead
+  EXPECT_EQ(alloc.UsesCpuCaches(), __rseq_size != 0);
+#endif
+
+  void *first = alloc.Allocate(64);
+  ASSERT_NE(first, nullptr);
+  EXPECT_GE(PerCpuSimpleAllocator::Size(first), 64);
+  alloc.Deallocate(first);
+  EXPECT_EQ(alloc.Allocate(64), first);
+
+  // The refill cut a batch of blocks, the next ones need no more of the buffer
+  const size_t extent = alloc.HeapExtent();
+  std::vector<void *> blocks;
+  for (size_t i = 0; i != 8; ++i) {
+    blocks.push_back(alloc.Allocate(64));
+    ASSERT_NE(blocks.back(), nullptr);
+  }
+  if (alloc.UsesCpuCaches()) {
+    EXPECT_EQ(alloc.HeapExtent(), extent);
+  }
+  for (void *memory : blocks) {
+    alloc.Deallocate(memory);
+  }
+
+  void *large = alloc.Allocate(256 * 1024);
+  ASSERT_NE(large, nullptr);
+  void *grown = alloc.Reallocate(large, 512 * 1024);
+  ASSERT_NE(grown, nullptr);
+  EXPECT_EQ(alloc.Reallocate(grown, 0), nullptr);
+}
+
+TEST(PerCpuSimpleAllocatorTest, LockedWithoutRseq) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  PerCpuSimpleAllocator alloc;
+  ASSERT_TRUE(alloc.Init(buffer.get(), BUFFER_SIZE, false));
+  EXPECT_FALSE(alloc.UsesCpuCaches());
+
+  void *memory = alloc.Allocate(64);
+  ASSERT_NE(memory, nullptr);
+  alloc.Deallocate(memory);
+  EXPECT_EQ(alloc.Allocate(64), memory);
+  RunThreads(alloc);
+}
+
+TEST(PerCpuSimpleAllocatorTest, ThreadsShareCpuCaches) {
+  auto buffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+  PerCpuSimpleAllocator alloc;
+  ASSERT_TRUE(alloc.Init(buffer.get(), BUFFER_SIZE));
+  RunThreads(alloc);
+  RunThreads(alloc);
+}
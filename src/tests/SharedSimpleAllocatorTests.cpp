@@ -0,0 +1,160 @@
+#include "SharedMemorySegment.h"
+#include "SharedSimpleAllocator.h"
+
+#include <csignal>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST(SharedSimpleAllocatorTest, AttachRequiresCreatedSegment) {
+  SharedMemorySegment segment;
+  ASSERT_TRUE(segment.CreateAnonymous(1024 * 1024));
+
+  SharedSimpleAllocator alloc;
+  EXPECT_FALSE(alloc.Attach(segment.Data()));
+  EXPECT_TRUE(alloc.Create(segment.Data(), segment.Size()));
+  EXPECT_FALSE(alloc.Create(segment.Data(), segment.Size()));
+
+  SharedSimpleAllocator attached_alloc;
+  EXPECT_TRUE(attached_alloc.Attach(segment.Data()));
+}
+
+TEST(SharedSimpleAllocatorTest, AllocateRespectsSegmentSize) {
+  SharedMemorySegment segment;
+  ASSERT_TRUE(segment.CreateAnonymous(64 * 1024));
+
+  SharedSimpleAllocator alloc;
+  ASSERT_TRUE(alloc.Create(segment.Data(), segment.Size()));
+  EXPECT_EQ(alloc.Allocate(0), nullptr);
+  EXPECT_EQ(alloc.Allocate(segment.Size()), nullptr);
+  EXPECT_NE(alloc.Allocate(1024), nullptr);
+}
+
+TEST(SharedSimpleAllocatorTest, MappingsAtDifferentAddressesShareHeap) {
+  SharedMemorySegment segment;
+  ASSERT_TRUE(segment.CreateAnonymous(4 * 1024 * 1024));
+  SharedMemorySegment other_mapping;
+  ASSERT_TRUE(other_mapping.OpenFd(segment.Fd()));
+  ASSERT_NE(segment.Data(), other_mapping.Data());
+
+  SharedSimpleAllocator producer;
+  ASSERT_TRUE(producer.Create(segment.Data(), segment.Size()));
+  SharedSimpleAllocator consumer;
+  ASSERT_TRUE(consumer.Attach(other_mapping.Data()));
+
+  auto *small = static_cast<char *>(producer.Allocate(100));
+  auto *large = static_cast<char *>(producer.Allocate(64 * 1024));
+  auto *last = producer.Allocate(10);
+  ASSERT_NE(small, nullptr);
+  ASSERT_NE(large, nullptr);
+  ASSERT_NE(last, nullptr);
+  std::strcpy(small, "small message");
+  std::strcpy(large, "large message");
+
+  auto *received_small = static_cast<char *>(consumer.FromOffset(producer.ToOffset(small)));
+  auto *received_large = static_cast<char *>(consumer.FromOffset(producer.ToOffset(large)));
+  EXPECT_STREQ(received_small, "small message");
+  EXPECT_STREQ(received_large, "large message");
+  EXPECT_EQ(SharedSimpleAllocator::Size(received_large), 64 * 1024);
+
+  consumer.Deallocate(received_small);
+  consumer.Deallocate(received_large);
+  EXPECT_EQ(producer.Allocate(100), small);
+  EXPECT_EQ(producer.Allocate(32 * 1024), large);
+}
+
+TEST(SharedSimpleAllocatorTest, ConsumerProcessFreesProducerMessages) {
+  SharedMemorySegment segment;
+  ASSERT_TRUE(segment.CreateAnonymous(4 * 1024 * 1024));
+  SharedSimpleAllocator consumer;
+  ASSERT_TRUE(consumer.Create(segment.Data(), segment.Size()));
+
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  constexpr size_t messages = 16;
+
+  const pid_t pid = fork();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    SharedMemorySegment producer_segment;
+    SharedSimpleAllocator producer;
+    if (!producer_segment.OpenFd(segment.Fd()) || !producer.Attach(producer_segment.Data())) {
+      _exit(1);
+    }
+    for (size_t i = 0; i != messages; ++i) {
+      const size_t size = (i + 1) * 3000;
+      auto *message = static_cast<uint8_t *>(producer.Allocate(size));
+      if (!message) {
+        _exit(2);
+      }
+      std::memset(message, static_cast<int>(i), size);
+      const uint64_t offset = producer.ToOffset(message);
+      if (write(pipe_fds[1], &offset, sizeof(offset)) != sizeof(offset)) {
+        _exit(3);
+      }
+    }
+    _exit(0);
+  }
+
+  for (size_t i = 0; i != messages; ++i) {
+    uint64_t offset = 0;
+    ASSERT_EQ(read(pipe_fds[0], &offset, sizeof(offset)), static_cast<ssize_t>(sizeof(offset)));
+    auto *message = static_cast<uint8_t *>(consumer.FromOffset(offset));
+    const size_t size = (i + 1) * 3000;
+    ASSERT_GE(SharedSimpleAllocator::Size(message), size);
+    for (size_t n = 0; n != size; ++n) {
+      ASSERT_EQ(message[n], static_cast<uint8_t>(i));
+    }
+    consumer.Deallocate(message);
+  }
+
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+TEST(SharedSimpleAllocatorTest, LockOfKilledProcessIsTakenOver) {
+  SharedMemorySegment segment;
+  ASSERT_TRUE(segment.CreateAnonymous(1024 * 1024));
+  SharedSimpleAllocator alloc;
+  ASSERT_TRUE(alloc.Create(segment.Data(), segment.Size()));
+  // Without a segment there is no lock to take
+  SharedSimpleAllocator detached;
+  EXPECT_EQ(detached.Allocate(16), nullptr);
+  detached.Deallocate(alloc.Allocate(16));
+#ifndef __linux__
+  GTEST_SKIP() << "the lock is robust on Linux only";
+#endif
+
+  // A child which spends almost all of its time under the lock is killed a few times, each kill likely lands in it
+  for (size_t round = 0; round != 8; ++round) {
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+      SharedSimpleAllocator child;
+      if (!child.Attach(segment.Data()) || write(pipe_fds[1], "x", 1) != 1) {
+        _exit(1);
+      }
+      for (;;) {
+        child.Deallocate(child.Allocate(100));
+      }
+    }
+    char started = 0;
+    ASSERT_EQ(read(pipe_fds[0], &started, 1), 1);
+    usleep(1000);
+    kill(pid, SIGKILL);
+    ASSERT_EQ(waitpid(pid, nullptr, 0), pid);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+
+    void *ptr = alloc.Allocate(100);
+    EXPECT_NE(ptr, nullptr);
+    alloc.Deallocate(ptr);
+  }
+}
@@ -1,8 +1,15 @@
 #include "SimpleAllocator.h"
+#include "StreamingCopy.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <gtest/gtest.h>
+#include <memory>
+#include <numeric>
+#include <tuple>
+#include <vector>
 #include <sanitizer/asan_interface.h>
 
 TEST(SimpleAllocatorTest, InitSetsBufferSize) {
@@ -43,6 +50,24 @@ TEST(SimpleAllocatorTest, AllocateRespectsBufferSize) {
   EXPECT_EQ(ptr, nullptr);
 }
 
+TEST(SimpleAllocatorTest, AllocateRejectsSizesWrappingWhenAligned) {
+  SimpleAllocator alloc;
+  auto buffer = std::make_unique<uint8_t[]>(64 * 1024);
+  alloc.Init(buffer.get(), 64 * 1024);
+  void *ptr = alloc.Allocate(100);
+  ASSERT_NE(ptr, nullptr);
+  const size_t size = SimpleAllocator::Size(ptr);
+  // Aligned, these sizes are 0 or just under SIZE_MAX, which would fall into the first slot or cut the buffer by a block header
+  for (const size_t huge_size : {SIZE_MAX, SIZE_MAX - 5, SIZE_MAX - 20, SIZE_MAX - 31}) {
+    EXPECT_EQ(alloc.Allocate(huge_size), nullptr) << huge_size;
+    EXPECT_EQ(alloc.AllocateAtLeast(huge_size).ptr, nullptr) << huge_size;
+    EXPECT_EQ(alloc.Reallocate(ptr, huge_size), nullptr) << huge_size;
+  }
+  EXPECT_EQ(SimpleAllocator::Size(ptr), size);
+  EXPECT_EQ(alloc.HeapExtent(), sizeof(MemoryBlock) + size);
+  EXPECT_TRUE(alloc.Validate());
+}
+
 TEST(SimpleAllocatorTest, DeallocateCanFreeMemory) {
   SimpleAllocator alloc;
   char buffer[100];
@@ -81,6 +106,9 @@ TEST(SimpleAllocatorTest, ReallocateReturnNullIfNoMemory) {
 }
 
 TEST(SimpleAllocatorTest, ReallocateReturnNullIfBufferOverflows) {
+  if (!SizeClasses::IS_LINEAR) {
+    GTEST_SKIP() << "the sizes are laid out for a slot per aligned size";
+  }
   SimpleAllocator alloc;
   char buffer[100];
   alloc.Init(buffer, sizeof(buffer));
@@ -119,6 +147,9 @@ TEST(SimpleAllocatorTest, DeallocateFreesExactAllocatedMemory) {
 }
 
 TEST(SimpleAllocatorTest, DeallocateReclaimMemory) {
+  if (!SizeClasses::IS_LINEAR) {
+    GTEST_SKIP() << "the sizes are laid out for a slot per aligned size";
+  }
   SimpleAllocator alloc;
   char buffer[100];
   alloc.Init(buffer, sizeof(buffer));
@@ -128,6 +159,321 @@ TEST(SimpleAllocatorTest, DeallocateReclaimMemory) {
   EXPECT_NE(new_ptr, nullptr);
 }
 
+TEST(SimpleAllocatorTest, AllocateAtLeastRoundsToAlignment) {
+  if (!SizeClasses::IS_LINEAR) {
+    GTEST_SKIP() << "the sizes are laid out for a slot per aligned size";
+  }
+  SimpleAllocator alloc;
+  char buffer[100];
+  alloc.Init(buffer, sizeof(buffer));
+  auto [ptr, size] = alloc.AllocateAtLeast(17);
+  EXPECT_NE(ptr, nullptr);
+  EXPECT_EQ(size, 32);
+
+  auto [no_ptr, no_size] = alloc.AllocateAtLeast(sizeof(buffer));
+  EXPECT_EQ(no_ptr, nullptr);
+  EXPECT_EQ(no_size, 0);
+}
+
+TEST(SimpleAllocatorTest, AllocateAtLeastReturnsUnsplitRemainder) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+
+  void *unsplit = alloc.Allocate(20000);
+  void *split = alloc.Allocate(64 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(unsplit);
+  alloc.Deallocate(split);
+
+  // The remainder of 3000 bytes is too small for the tree and stays with the block
+  auto [ptr, size] = alloc.AllocateAtLeast(17000);
+  EXPECT_EQ(ptr, unsplit);
+  EXPECT_EQ(size, 20000);
+  std::memset(ptr, 0, size);
+
+  auto [split_ptr, split_size] = alloc.AllocateAtLeast(16 * 1024);
+  EXPECT_EQ(split_ptr, split);
+  EXPECT_EQ(split_size, 16 * 1024);
+}
+
+TEST(SimpleAllocatorTest, TreeBlockRemainderGoesToSlot) {
+  if (!SizeClasses::IS_LINEAR) {
+    GTEST_SKIP() << "the rests are laid out for a slot per aligned size";
+  }
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  alloc.SetSlotSplitThreshold(1024);
+
+  void *small_rest = alloc.Allocate(20000);
+  void *large_rest = alloc.Allocate(64 * 1024);
+  void *huge_string = alloc.Allocate(32 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(small_rest);
+  alloc.Deallocate(large_rest);
+  alloc.Deallocate(huge_string);
+
+  // The remainder of about 3000 bytes is too small for the tree but over the threshold, it is split off into its slot
+  auto [ptr, size] = alloc.AllocateAtLeast(17000);
+  EXPECT_EQ(ptr, small_rest);
+  EXPECT_GE(size, 17000);
+  EXPECT_LT(size, 18000);
+  std::memset(ptr, 0, size);
+  EXPECT_EQ(alloc.Allocate(20000 - size - sizeof(MemoryBlock)), static_cast<char *>(ptr) + size + sizeof(MemoryBlock));
+
+  // A string of 16 KiB + 1 from a 32 KiB block leaves almost half of it to a slot
+  void *string = alloc.Allocate(16 * 1024 + 1);
+  EXPECT_EQ(string, huge_string);
+  EXPECT_LT(SimpleAllocator::Size(string), 16 * 1024 + 1024);
+
+  auto [split_ptr, split_size] = alloc.AllocateAtLeast(16 * 1024);
+  EXPECT_EQ(split_ptr, large_rest);
+  EXPECT_EQ(split_size, 16 * 1024);
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, ReallocateGrowthTakesHeadroom) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+
+  // Something always lands after the block, so it never grows at the end of the heap
+  void *ptr = alloc.Allocate(32);
+  alloc.Allocate(16);
+  size_t moves = 0;
+  for (size_t size = 48; size <= 64 * 1024; size += 16) {
+    void *new_ptr = alloc.Reallocate(ptr, size);
+    ASSERT_NE(new_ptr, nullptr);
+    if (new_ptr != ptr) {
+      ++moves;
+      alloc.Allocate(16);
+    }
+    ptr = new_ptr;
+  }
+  EXPECT_LT(moves, 16);
+  EXPECT_EQ(alloc.Reallocate(ptr, SimpleAllocator::Size(ptr) * 3 / 4), ptr);
+  EXPECT_TRUE(alloc.Validate());
+
+  // A freed block forgets its growth, the next one to grow takes only what it asks for
+  const size_t block_size = SimpleAllocator::Size(ptr);
+  alloc.Deallocate(ptr);
+  EXPECT_EQ(alloc.Allocate(block_size), ptr);
+  EXPECT_EQ(SimpleAllocator::Size(alloc.Reallocate(ptr, block_size + 16)), block_size + 16);
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, ReallocateWithStreamingCopyKeepsContent) {
+  constexpr size_t buffer_size = 4 * 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  alloc.SetStreamingCopyThreshold(0);
+
+  // Sizes around the vector widths and the head and tail of the aligned body
+  for (size_t size : {1, 15, 16, 130, 1000, 100000}) {
+    auto *ptr = static_cast<uint8_t *>(alloc.Allocate(size));
+    for (size_t i = 0; i != size; ++i) {
+      ptr[i] = static_cast<uint8_t>(i * 7);
+    }
+    alloc.Allocate(16);
+    ptr = static_cast<uint8_t *>(alloc.Reallocate(ptr, 2 * size + 16));
+    ASSERT_NE(ptr, nullptr);
+    for (size_t i = 0; i != size; ++i) {
+      ASSERT_EQ(ptr[i], static_cast<uint8_t>(i * 7));
+    }
+  }
+
+  // Destinations off the vector alignment
+  std::vector<uint8_t> source(4096);
+  std::iota(source.begin(), source.end(), uint8_t{0});
+  for (size_t offset : {1, 8, 17, 31}) {
+    std::vector<uint8_t> destination(source.size() + offset);
+    StreamingCopy(destination.data() + offset, source.data(), source.size() - offset);
+    EXPECT_TRUE(std::equal(source.begin(), source.end() - static_cast<ptrdiff_t>(offset), destination.begin() + static_cast<ptrdiff_t>(offset)));
+  }
+}
+
+TEST(SimpleAllocatorTest, WarmupCarvesSlotBlocks) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  // The block sizes of the classes of 64 and 1000 bytes, from a second allocator
+  SimpleAllocator sizes_alloc;
+  char sizes_buffer[4096];
+  sizes_alloc.Init(sizes_buffer, sizeof(sizes_buffer));
+  const size_t small_size = SimpleAllocator::Size(sizes_alloc.Allocate(64));
+  const size_t large_size = SimpleAllocator::Size(sizes_alloc.Allocate(1000));
+
+  const WarmupProfile::SlotBlocks slot_blocks[] = {{64, 3}, {1000, 2}};
+  EXPECT_TRUE(alloc.Warmup({buffer_size, slot_blocks}));
+  const size_t carved_extent = alloc.HeapExtent();
+  EXPECT_EQ(carved_extent, 3 * (16 + small_size) + 2 * (16 + large_size));
+
+  // The carved blocks come out in the order of addresses, without cutting the buffer
+  void *first = alloc.Allocate(64);
+  EXPECT_LT(first, alloc.Allocate(64));
+  alloc.Allocate(64);
+  alloc.Allocate(1000);
+  EXPECT_EQ(alloc.HeapExtent(), carved_extent);
+  alloc.Allocate(64);
+  EXPECT_GT(alloc.HeapExtent(), carved_extent);
+  EXPECT_TRUE(alloc.Validate());
+
+  const WarmupProfile::SlotBlocks too_large[] = {{64 * 1024, 1}};
+  EXPECT_FALSE(alloc.Warmup({0, too_large}));
+  const WarmupProfile::SlotBlocks too_many[] = {{4096, buffer_size / 4096}};
+  EXPECT_FALSE(alloc.Warmup({0, too_many}));
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, UnsortedBinReusesRecentLargeBlocks) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+
+  void *first = alloc.Allocate(32 * 1024);
+  void *second = alloc.Allocate(48 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(first);
+  alloc.Deallocate(second);
+  EXPECT_TRUE(alloc.Validate());
+
+  // A near fit is handed out whole, a miss sorts the bin and splits the best fit from the tree
+  EXPECT_EQ(alloc.Allocate(30 * 1024), first);
+  EXPECT_EQ(SimpleAllocator::Size(first), 32 * 1024);
+  EXPECT_EQ(alloc.Allocate(20 * 1024), second);
+  EXPECT_EQ(SimpleAllocator::Size(second), 20 * 1024);
+  EXPECT_TRUE(alloc.Validate());
+
+  // An overflow sorts the bin into the tree, the last block freed is still reused first
+  std::vector<void *> blocks;
+  for (size_t i = 0; i != SimpleAllocatorTraits::UNSORTED_BIN_SIZE + 1; ++i) {
+    blocks.push_back(alloc.Allocate(20 * 1024));
+  }
+  alloc.Allocate(16);
+  for (void *block : blocks) {
+    alloc.Deallocate(block);
+  }
+  EXPECT_TRUE(alloc.Validate());
+  EXPECT_EQ(alloc.Allocate(20 * 1024), blocks.back());
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, DeferredFreeWaitsForFlush) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  alloc.SetDeferredFree(true);
+
+  void *large = alloc.Allocate(64 * 1024);
+  void *small = alloc.Allocate(64);
+  alloc.Allocate(16);
+  alloc.Deallocate(large);
+  alloc.Deallocate(small);
+  EXPECT_TRUE(alloc.Validate());
+
+  // Small blocks go to their slots right away, large ones only after the flush
+  EXPECT_EQ(alloc.Allocate(64), small);
+  void *other = alloc.Allocate(64 * 1024);
+  EXPECT_NE(other, large);
+  alloc.FlushDeferred();
+  EXPECT_EQ(alloc.Allocate(64 * 1024), large);
+
+  // Disabling flushes the waiting blocks
+  alloc.Deallocate(large);
+  alloc.SetDeferredFree(false);
+  EXPECT_EQ(alloc.Allocate(64 * 1024), large);
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, DeferredFreeFlushesWhenBufferRunsOut) {
+  constexpr size_t buffer_size = 256 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  alloc.SetDeferredFree(true);
+
+  void *large = alloc.Allocate(160 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(large);
+  EXPECT_EQ(alloc.Allocate(128 * 1024), large);
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, ForEachBlockReportsFreeAndUsedBlocks) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+
+  void *slot_block = alloc.Allocate(100);
+  void *used = alloc.Allocate(32);
+  void *tree_block = alloc.Allocate(64 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(slot_block);
+  alloc.Deallocate(tree_block);
+
+  std::vector<std::tuple<void *, size_t, bool>> blocks;
+  alloc.ForEachBlock([&blocks](void *ptr, size_t size, bool free) { blocks.emplace_back(ptr, size, free); });
+  ASSERT_EQ(blocks.size(), 4);
+  EXPECT_EQ(blocks[0], std::make_tuple(slot_block, SimpleAllocator::Size(slot_block), true));
+  EXPECT_EQ(blocks[1], std::make_tuple(used, SimpleAllocator::Size(used), false));
+  EXPECT_EQ(blocks[2], std::make_tuple(tree_block, size_t{64 * 1024}, true));
+  EXPECT_FALSE(std::get<2>(blocks[3]));
+
+  // The marks are gone after the walk
+  EXPECT_EQ(SimpleAllocator::Size(slot_block) % 16, 0);
+  EXPECT_TRUE(alloc.Validate());
+}
+
+TEST(SimpleAllocatorTest, ValidateCatchesCorruption) {
+  constexpr size_t buffer_size = 1024 * 1024;
+  auto buffer = std::make_unique<char[]>(buffer_size);
+  SimpleAllocator alloc;
+  alloc.Init(buffer.get(), buffer_size);
+  EXPECT_TRUE(alloc.Validate());
+
+  void *first = alloc.Allocate(48);
+  const size_t first_size = SimpleAllocator::Size(first);
+  void *second = alloc.Allocate(48);
+  void *large = alloc.Allocate(32 * 1024);
+  alloc.Allocate(16);
+  alloc.Deallocate(first);
+  alloc.Deallocate(large);
+  EXPECT_TRUE(alloc.Validate());
+  // A miss of the unsorted bin sorts the large block into the tree
+  alloc.Allocate(64 * 1024);
+  EXPECT_TRUE(alloc.Validate());
+
+  // An overflow into the header of the next block breaks the tiling of the buffer
+  auto *header = reinterpret_cast<size_t *>(reinterpret_cast<uintptr_t>(second) - 16);
+  const size_t second_size = *header;
+  *header = 1 << 20;
+  EXPECT_FALSE(alloc.Validate());
+  *header = second_size;
+
+#ifndef SIMPLE_ALLOCATOR_COMPACT_INDEX
+  // A tree node pointing out of the heap
+  auto *left = static_cast<void **>(large);
+  *left = buffer.get() + buffer_size;
+  EXPECT_FALSE(alloc.Validate());
+  *left = nullptr;
+  EXPECT_TRUE(alloc.Validate());
+#endif
+
+  // A double free makes a cycle in the slot list, the marks of the failed check are cleared
+  alloc.Deallocate(first);
+  EXPECT_FALSE(alloc.Validate());
+  EXPECT_EQ(SimpleAllocator::Size(first), first_size);
+}
+
 namespace {
 
 struct AllocatedMemory {
@@ -163,6 +509,9 @@ TEST(SimpleAllocatorTest, SmokeTest) {
   std::vector<AllocatedMemory> allocated_memory;
   std::srand(std::time(nullptr));
   for (size_t i = 0; i != 4000000; ++i) {
+    if (i % 500000 == 0) {
+      ASSERT_TRUE(alloc.Validate());
+    }
     const auto r = static_cast<size_t>(std::rand());
 
     size_t size = (r + 115249) % (1024 * 16);
@@ -222,4 +571,5 @@ TEST(SimpleAllocatorTest, SmokeTest) {
     MarkMemory(mem);
     alloc.Deallocate(mem.ptr);
   }
+  EXPECT_TRUE(alloc.Validate());
 }
@@ -0,0 +1,29 @@
+#include "SizeClassGenerator.h"
+#include "SizeProfile.h"
+
+#include <gtest/gtest.h>
+
+TEST(SizeClassGeneratorTest, ClassPerSizeWithoutWaste) {
+  const std::vector<SizeCount> profile{{24, 100}, {48, 10}, {4096, 5}, {1024 * 1024, 7}};
+  const auto classes = GenerateSizeClasses(profile, 8);
+  EXPECT_EQ(classes, (std::vector<uint32_t>{32, 48, 4096, 16368}));
+  EXPECT_EQ(GetRoundingWaste(profile, classes), 100 * 8);
+}
+
+TEST(SizeClassGeneratorTest, FewClassesFollowTheCounts) {
+  const std::vector<SizeCount> profile{{32, 1000}, {48, 1}, {64, 1000}, {128, 1000}, {160, 1}};
+  const auto classes = GenerateSizeClasses(profile, 4);
+  // A rare size may rather go to the largest class than cost a class to a frequent one
+  EXPECT_EQ(classes, (std::vector<uint32_t>{32, 64, 128, 16368}));
+  EXPECT_EQ(GetRoundingWaste(profile, classes), 16 + 16368 - 160);
+
+  EXPECT_EQ(GenerateSizeClasses(profile, 1), (std::vector<uint32_t>{16368}));
+}
+
+TEST(SizeClassGeneratorTest, ProfileBuckets) {
+  EXPECT_EQ(SizeProfile::GetBucketSize(SizeProfile::GetBucketIndex(1)), 16);
+  EXPECT_EQ(SizeProfile::GetBucketSize(SizeProfile::GetBucketIndex(16368)), 16368);
+  EXPECT_EQ(SizeProfile::GetBucketSize(SizeProfile::GetBucketIndex(16369)), 16384);
+  EXPECT_EQ(SizeProfile::GetBucketSize(SizeProfile::GetBucketIndex(40000)), 32768);
+  EXPECT_EQ(SizeProfile::GetBucketIndex(~size_t{0}), SizeProfile::SLOT_BUCKETS + SizeProfile::LARGE_BUCKETS - 1);
+}
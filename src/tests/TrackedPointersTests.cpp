@@ -0,0 +1,30 @@
+#include "TrackedPointers.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+TEST(TrackedPointersTest, FindsOwnersUntilErased) {
+  auto pointers = std::make_unique<TrackedPointers>();
+  auto *first_owner = reinterpret_cast<BenchmarkBackend *>(uintptr_t{0x1000});
+  auto *second_owner = reinterpret_cast<BenchmarkBackend *>(uintptr_t{0x2000});
+  int on_stack = 0;
+  EXPECT_EQ(pointers->Find(&on_stack), nullptr);
+
+  // Enough pointers for the table to grow a few times, with neighbours probing over each other
+  std::vector<uint8_t> memory(64 * 1024 * 16);
+  for (size_t i = 0; i != memory.size(); i += 16) {
+    ASSERT_TRUE(pointers->Insert(&memory[i], i % 32 ? first_owner : second_owner));
+  }
+  EXPECT_EQ(pointers->Count(), memory.size() / 16);
+  for (size_t i = 0; i != memory.size(); i += 32) {
+    pointers->Erase(&memory[i]);
+  }
+  pointers->Erase(&on_stack);
+  EXPECT_EQ(pointers->Count(), memory.size() / 32);
+
+  for (size_t i = 0; i != memory.size(); i += 16) {
+    EXPECT_EQ(pointers->Find(&memory[i]), i % 32 ? first_owner : nullptr);
+  }
+  EXPECT_EQ(pointers->Find(&on_stack), nullptr);
+}
@@ -0,0 +1,57 @@
+// Simple Allocator 2024
+#include "SizeClassGenerator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Reads a size profile written by the replacement library with SIMPLE_ALLOCATOR_SIZE_PROFILE=<file>
+// and prints a size class table for SIMPLE_ALLOCATOR_SIZE_CLASSES=<header>.
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "Usage: %s <size profile> [max classes, 32 by default] > size_classes.h\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const size_t max_classes = argc == 3 ? std::strtoull(argv[2], nullptr, 10) : 32;
+  if (!max_classes || max_classes > SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT - 1) {
+    std::fprintf(stderr, "The number of classes must be from 1 to %zu\n", SimpleAllocatorTraits::MAX_SLOT_SIZE / SimpleAllocatorTraits::ALIGNMENT - 1);
+    return EXIT_FAILURE;
+  }
+
+  std::FILE *file = std::fopen(argv[1], "r");
+  if (!file) {
+    std::fprintf(stderr, "Failed to open %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  std::vector<SizeCount> profile;
+  uint64_t slot_requests = 0;
+  uint64_t tree_requests = 0;
+  char line[256];
+  while (std::fgets(line, sizeof(line), file)) {
+    unsigned long long size = 0;
+    unsigned long long count = 0;
+    if (line[0] == '#' || std::sscanf(line, "%llu %llu", &size, &count) != 2) {
+      continue;
+    }
+    profile.push_back({size, count});
+    (size < SimpleAllocatorTraits::MAX_SLOT_SIZE ? slot_requests : tree_requests) += count;
+  }
+  std::fclose(file);
+
+  const std::vector<uint32_t> classes = GenerateSizeClasses(profile, max_classes);
+  const uint64_t waste = GetRoundingWaste(profile, classes);
+  std::fprintf(stderr, "%zu classes, %llu slot and %llu tree requests, %.1f bytes of rounding per slot request\n", classes.size(),
+               static_cast<unsigned long long>(slot_requests), static_cast<unsigned long long>(tree_requests),
+               slot_requests ? static_cast<double>(waste) / static_cast<double>(slot_requests) : 0.0);
+
+  std::printf("// Simple Allocator 2024\n");
+  std::printf("// Generated by generate-size-classes from %s\n", argv[1]);
+  std::printf("#ifndef PROFILEDSIZECLASSES_H\n#define PROFILEDSIZECLASSES_H\n#include <array>\n#include <cstdint>\n\n");
+  std::printf("inline constexpr std::array<uint32_t, %zu> PROFILED_SIZE_CLASSES{{", classes.size());
+  for (size_t i = 0; i != classes.size(); ++i) {
+    std::printf("%s%u,", i % 16 ? " " : "\n  ", classes[i]);
+  }
+  std::printf("\n}};\n\n#endif // PROFILEDSIZECLASSES_H\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+// Simple Allocator 2024
+#ifndef SIZECLASSGENERATOR_H
+#define SIZECLASSGENERATOR_H
+#include "SimpleAllocatorTraits.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Requests of one size in a size profile
+struct SizeCount {
+  size_t size;
+  uint64_t count;
+};
+
+// Bytes lost to rounding the profiled slot requests up to their classes, classes must be ascending and cover every request
+inline uint64_t GetRoundingWaste(const std::vector<SizeCount> &profile, const std::vector<uint32_t> &classes) noexcept {
+  uint64_t waste = 0;
+  for (const auto &[size, count] : profile) {
+    if (size && size < SimpleAllocatorTraits::MAX_SLOT_SIZE) {
+      waste += (*std::lower_bound(classes.begin(), classes.end(), size) - size) * count;
+    }
+  }
+  return waste;
+}
+
+// Picks at most max_classes slot sizes with the least rounding waste for the profile.
+// Class sizes are the profiled sizes, aligned, plus the largest slot block, so every request below the cutoff has a class.
+inline std::vector<uint32_t> GenerateSizeClasses(const std::vector<SizeCount> &profile, size_t max_classes) {
+  constexpr size_t ALIGNMENT = SimpleAllocatorTraits::ALIGNMENT;
+  std::map<size_t, uint64_t> counts;
+  for (const auto &[size, count] : profile) {
+    if (size && size < SimpleAllocatorTraits::MAX_SLOT_SIZE) {
+      counts[(size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)] += count;
+    }
+  }
+  counts.try_emplace(SimpleAllocatorTraits::MAX_SLOT_SIZE - ALIGNMENT, 0);
+
+  std::vector<size_t> sizes;
+  std::vector<uint64_t> count_prefix{0};
+  std::vector<uint64_t> bytes_prefix{0};
+  for (const auto &[size, count] : counts) {
+    sizes.push_back(size);
+    count_prefix.push_back(count_prefix.back() + count);
+    bytes_prefix.push_back(bytes_prefix.back() + size * count);
+  }
+
+  // Waste of the sizes first..last in the class of the size last
+  const auto class_waste = [&](size_t first, size_t last) {
+    return sizes[last] * (count_prefix[last + 1] - count_prefix[first]) - (bytes_prefix[last + 1] - bytes_prefix[first]);
+  };
+
+  // Least waste of the sizes 0..last with a given number of classes, the last one ending at the size last, and where the class begins
+  const size_t n = sizes.size();
+  const size_t classes_count = std::clamp<size_t>(max_classes, 1, n);
+  std::vector<std::vector<uint64_t>> waste(classes_count, std::vector<uint64_t>(n, std::numeric_limits<uint64_t>::max()));
+  std::vector<std::vector<size_t>> class_begin(classes_count, std::vector<size_t>(n, 0));
+  for (size_t last = 0; last != n; ++last) {
+    waste[0][last] = class_waste(0, last);
+  }
+  for (size_t k = 1; k != classes_count; ++k) {
+    for (size_t last = k; last != n; ++last) {
+      for (size_t first = k; first <= last; ++first) {
+        const uint64_t candidate = waste[k - 1][first - 1] + class_waste(first, last);
+        if (candidate < waste[k][last]) {
+          waste[k][last] = candidate;
+          class_begin[k][last] = first;
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> classes(classes_count);
+  for (size_t k = classes_count, last = n - 1; k--;) {
+    classes[k] = static_cast<uint32_t>(sizes[last]);
+    if (k) {
+      last = class_begin[k][last] - 1;
+    }
+  }
+  return classes;
+}
+
+#endif // SIZECLASSGENERATOR_H